@@ -1,6 +1,7 @@
 #include "coremin.h"
 
 Malloc * gMalloc = nullptr;
+MallocLinear * gFrameMalloc = nullptr;
 
 int32 main()
 {
@@ -1,10 +1,19 @@
 #include "core/engine_loop.h"
 #include "gldrv/gldrv.h"
+#include "hal/platform_memory.h"
+#include "hal/malloc_linear.h"
 
 int32 EngineLoop::preInit()
 {
 	/** @todo Lots of stuff missing here */
 
+	// Per-frame allocator
+	gFrameMalloc = new MallocLinear(frameMallocSize);
+
+	// Periodic allocator stats, one JSON object per line
+	if (const char * memoryStatsPath = ::getenv("SGL_MALLOC_STATS"))
+		memoryStatsFile = ::fopen(memoryStatsPath, "a");
+
 	// Init application
 	AppMisc::init();
 
@@ -13,4 +22,30 @@ int32 EngineLoop::preInit()
 
 	/// @todo Make this RHIInit()
 	initOpenGL();
+}
+
+void EngineLoop::tick()
+{
+	// Blocks of the oldest frame are released
+	gFrameMalloc->nextFrame();
+
+	/// @todo Tick all systems
+
+	// Give back unused memory every now and then
+	if (++numTicks % trimInterval == 0) gMalloc->trim();
+
+	if (memoryStatsFile && numTicks % memoryStatsInterval == 0)
+	{
+		gMalloc->writeStats(memoryStatsFile);
+		::fflush(memoryStatsFile);
+	}
+}
+
+void EngineLoop::exit()
+{
+	if (memoryStatsFile) ::fclose(memoryStatsFile);
+	memoryStatsFile = nullptr;
+
+	delete gFrameMalloc;
+	gFrameMalloc = nullptr;
 }
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include "generic/generic_platform_memory.h"
 #include "hal/malloc_ansi.h"
+#include <new>
 
 Malloc * GenericPlatformMemory::baseMalloc()
 {
-	return new MallocAnsi;
+	// Not allocated with operator new, which may route to gMalloc
+	alignas(MallocAnsi) static uint8 storage[sizeof(MallocAnsi)];
+	static Malloc * const malloc = new (storage) MallocAnsi;
+	return malloc;
 }
\ No newline at end of file
@@ -5,6 +5,18 @@
 	#include <malloc.h>
 #endif
 
+MallocAnsi::MallocAnsi()
+{
+#if PLATFORM_UNIX
+	// A fixed threshold stops glibc from raising it
+	// dynamically, so that large blocks are always
+	// mapped and realloc can move them with mremap.
+	// This is a process-wide setting, applied once
+	static const bool bThresholdSet = ::mallopt(M_MMAP_THRESHOLD, MALLOC_ANSI_MMAP_THRESHOLD) != 0;
+	(void)bThresholdSet;
+#endif
+}
+
 void * MallocAnsi::malloc(uintP n, uint32 alignment)
 {
 	// Compute min alignment
@@ -30,9 +42,17 @@ void * MallocAnsi::realloc(void * original, uintP n, uint32 alignment)
 
 	if (original && n)
 	{
-		// Do not even try to realloc in place
-		// But why??
+		// Block is already large enough
 		uintP usable = malloc_usable_size(original);
+		if (n <= usable && (reinterpret_cast<uintP>(original) & (alignment - 1)) == 0)
+			return original;
+
+		// Malloc alignment suffices, let glibc grow
+		// in place or remap the pages of large blocks
+		if (alignment <= 16)
+			return ::realloc(original, n);
+
+		// Over-aligned, copy to a new block
 		if (UNLIKELY(::posix_memalign(&out, alignment, n) != 0))
 			return nullptr;
 		else if (LIKELY(usable))
@@ -78,4 +98,11 @@ bool MallocAnsi::getAllocSize(void * original, uintP & n)
 #endif
 
 	return true;
+}
+
+void MallocAnsi::trim()
+{
+#if PLATFORM_UNIX
+	::malloc_trim(0);
+#endif
 }
\ No newline at end of file
@@ -1,52 +1,206 @@
 #include "hal/malloc_binned.h"
 
-MallocBinned::MallocBinned() :
+MallocBinned::MallocBinned(Malloc * _backupMalloc) :
 	buckets{},
-	root(nullptr)
+	numNodes(1),
+	getNode(&PlatformMemory::getCurrentNode),
+	pageMap{},
+	root(nullptr),
+	cacheSlot(PlatformTLS::allocateSlot(&MallocBinned::destroyCache)),
+	caches(nullptr),
+	backupMalloc(_backupMalloc ? _backupMalloc : &mappedMalloc),
+	numRetainedPools(MALLOC_BINNED_TRIM_RETAINED_POOLS),
+	numPools(0),
+	numUnmappedPools(0)
 {
-	// Create pools
+	// Cache at most MALLOC_BINNED_CACHE_MAX_BYTES per bin
+	// Pools are created on first use
 	for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
-		createPool(i);
+		cacheLimits[i] = PlatformMath::min<sizet>(MALLOC_BINNED_CACHE_MAX_BYTES / getBucketBlockSize(i), MALLOC_BINNED_CACHE_MAX_BLOCKS);
+
+#if MALLOC_BINNED_NUMA
+	numNodes = PlatformMath::min<uint32>(PlatformMemory::getNumNodes(), MALLOC_BINNED_MAX_NODES);
+#endif
 }
 
-void * MallocBinned::malloc(sizet n, uint32 alignment)
+void MallocBinned::setTopology(uint32 _numNodes, uint32 (*_getNode)())
 {
-	if (n > MALLOC_BINNED_BLOCK_MAX_SIZE)
-		// Use global allocator
-		return gMalloc->malloc(n, alignment);
-	
-	// Find bucket index
-	uint32 bucketIdx = getBucketIndex(n);
+	numNodes = PlatformMath::min<uint32>(PlatformMath::max<uint32>(_numNodes, 1), MALLOC_BINNED_MAX_NODES);
+	getNode = _getNode ? _getNode : &PlatformMemory::getCurrentNode;
+}
 
-	{
-		// Try first pool
-		PoolLinkRef head = buckets[bucketIdx];
-		if (head->data.numFreeBlocks)
-			return head->data.malloc(n);
+MallocPool * MallocBinned::findPoolInTree(void * address)
+{
+	// Tree may be modified by other threads
+	ScopeLock poolsLock(&poolsCS);
 
-		// Find next free pool
-		PoolLinkRef it = head->next;
-		while (it && it->data.numFreeBlocks == 0) it = it->next;
+	// Search key
+	Pair<void*, MallocPool*> searchKey(address);
 
-		if (it)
+	PoolNodeRef it = root;
+	while (it)
+	{
+		if (searchKey < it->data)
+			it = it->left;
+		else
 		{
-			// Bring forth
-			it->unlink();
-			it->linkNext(head);
-			buckets[bucketIdx] = it;
+			MallocPool * pool = it->data.second;
+			if (pool->hasBlock(address))
+				return pool;
+			else
+				it = it->right;
+		}
+	}
+
+	return nullptr;
+}
+
+MallocBinned::ThreadCache * MallocBinned::createCache()
+{
+	// Don't allocate the cache with ourselves
+	ThreadCache * cache = reinterpret_cast<ThreadCache*>(::calloc(1, sizeof(ThreadCache)));
+	if (UNLIKELY(cache == nullptr)) return nullptr;
+
+	cache->owner = this;
 
-			// Allocate and return
-			return it->data.malloc(n);
+	// Threads are assumed not to migrate across nodes
+	cache->node = numNodes > 1 ? getNode() % numNodes : 0;
+
+	{
+		// Link in caches list
+		ScopeLock poolsLock(&poolsCS);
+		cache->next = caches;
+		caches = cache;
+	}
+
+	PlatformTLS::setValue(cacheSlot, cache);
+	return cache;
+}
+
+void MallocBinned::destroyCache(void * _cache)
+{
+	ThreadCache * cache = reinterpret_cast<ThreadCache*>(_cache);
+	MallocBinned * owner = cache->owner;
+
+	// Give back all cached blocks
+	for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+		owner->flushBin(cache->bins[i], cache->bins[i].count);
+
+	{
+		// Unlink from caches list
+		ScopeLock poolsLock(&owner->poolsCS);
+
+		ThreadCache ** it = &owner->caches;
+		while (*it != cache) it = &(*it)->next;
+		*it = cache->next;
+	}
+
+	::free(cache);
+}
+
+bool MallocBinned::refillBin(ThreadCache::Bin & bin, uint32 bucketIdx, uint32 nodeIdx)
+{
+	// Move half of the bin capacity, at least one block
+	const uint32 batchSize = PlatformMath::max(cacheLimits[bucketIdx] / 2, 1U);
+
+	ScopeLock bucketLock(&bucketsCS[nodeIdx][bucketIdx]);
+
+	for (uint32 i = 0; i < batchSize; ++i)
+	{
+		void * block = allocateFromBucket(bucketIdx, nodeIdx);
+		if (UNLIKELY(block == nullptr)) break;
+
+		// Push in bin
+		*reinterpret_cast<void**>(block) = bin.head;
+		bin.head = block;
+		bin.setCount(bin.count + 1);
+	}
+
+	return bin.head != nullptr;
+}
+
+void MallocBinned::flushBin(ThreadCache::Bin & bin, uint32 n)
+{
+	// Pool of the current chain
+	MallocPool * pool = nullptr;
+	void * first = nullptr, * last = nullptr;
+
+	for (; n > 0 && bin.head; --n)
+	{
+		// Pop from bin
+		void * block = bin.head;
+		bin.head = *reinterpret_cast<void**>(block);
+		bin.setCount(bin.count - 1);
+
+		MallocPool * owner = findPool(block);
+		if (owner == pool)
+		{
+			// Extend chain of the same pool
+			MallocPool::setNext(last, block);
+			last = block;
 		}
 		else
 		{
-			MallocPool * pool;
-			if (pool = createPool(bucketIdx))
-				return pool->malloc(n);
+			// Push previous chain to its pool
+			if (pool) pool->freeRemote(first, last);
+
+			pool = owner;
+			first = last = block;
 		}
 	}
 
-	return nullptr;
+	if (pool) pool->freeRemote(first, last);
+}
+
+bool MallocBinned::releasePool(PoolLinkRef link, uint32 bucketIdx, uint32 nodeIdx)
+{
+	ScopeLock poolsLock(&poolsCS);
+
+	// Tree doesn't support removal
+	if (!unmapPool(&link->data)) return false;
+
+	// Unlink from bucket
+	if (buckets[nodeIdx][bucketIdx] == link) buckets[nodeIdx][bucketIdx] = link->next;
+	link->unlink();
+
+	// Free pool buffer and header
+	PlatformMemory::unmap(link->data.pool, MALLOC_BINNED_POOL_SIZE);
+	::free(link);
+
+	--numPools;
+	return true;
+}
+
+void * MallocBinned::malloc(sizet n, uint32 alignment)
+{
+	if (isBackupRequest(n, alignment))
+		// Use backup allocator
+		return backupMalloc->malloc(n, alignment);
+	
+	// Find bucket index, blocks are aligned to their size
+	const uint32 bucketIdx = UNLIKELY(alignment > MALLOC_BINNED_BLOCK_ALIGNMENT) ? getBucketIndex(n, alignment) : getBucketIndex(n);
+
+	if (UNLIKELY(cacheLimits[bucketIdx] == 0))
+	{
+		// Too large to be cached
+		const uint32 nodeIdx = getThreadNode();
+		ScopeLock bucketLock(&bucketsCS[nodeIdx][bucketIdx]);
+		return allocateFromBucket(bucketIdx, nodeIdx);
+	}
+
+	ThreadCache * cache = getCache();
+	if (UNLIKELY(cache == nullptr)) return nullptr;
+
+	// Refill empty bin
+	ThreadCache::Bin & bin = cache->bins[bucketIdx];
+	if (UNLIKELY(bin.head == nullptr) && !refillBin(bin, bucketIdx, cache->node)) return nullptr;
+
+	// Pop from bin
+	void * out = bin.head;
+	bin.head = *reinterpret_cast<void**>(out);
+	bin.setCount(bin.count - 1);
+
+	return out;
 }
 
 void * MallocBinned::realloc(void * original, sizet n, uint32 alignment)
@@ -57,54 +211,44 @@ void * MallocBinned::realloc(void * original, sizet n, uint32 alignment)
 	void * out;
 
 	// Find pool that alloc'd this block
-
-	// Search key
-	Pair<void*, MallocPool*> searchKey(original);
-
-	PoolNodeRef it = root;
-	while (it)
+	if (MallocPool * pool = findPool(original))
 	{
-		if (searchKey < it->data)
-			it = it->left;
+		if (n <= pool->blockSize && (reinterpret_cast<uintP>(original) & (alignment - 1)) == 0)
+			// No need to reallocate
+			return original;
 		else
 		{
-			MallocPool * pool = it->data.second;
-			if (pool->hasBlock(original))
-			{
-				if (n < pool->blockSize)
-					// No need to reallocate
-					return original;
-				else
-				{
-					// Allocate new and copy memory
-					out = malloc(n, alignment);
-					Memory::memcpy(out, original, n);
-
-					// Free original
-					pool->free(original);
-
-					return out;
-				}
-			}
-			else
-				it = it->right;
+			// Allocate new and copy memory, new block
+			// may be smaller if moved for alignment
+			out = malloc(n, alignment);
+			if (out) Memory::memcpy(out, original, PlatformMath::min<sizet>(n, pool->blockSize));
+
+			// Free original
+			free(original);
+
+			return out;
 		}
 	}
 
-	printf("backup\n");
-
 	// Memory was alloc'd by the backup allocator
 	if (n > MALLOC_BINNED_BLOCK_MAX_SIZE)
 		// Let the backup allocator handle realloc
-		return gMalloc->realloc(original, n, alignment);
+		return backupMalloc->realloc(original, n, alignment);
 	else
 	{
+		// Old block may be smaller, if it was
+		// over-aligned; if its size is unknown,
+		// let the backup allocator handle realloc
+		sizet oldSize;
+		if (UNLIKELY(!backupMalloc->getAllocSize(original, oldSize)))
+			return backupMalloc->realloc(original, n, alignment);
+
 		// Allocate new out of pool
-		out = malloc(n);
-		Memory::memcpy(out, original, n);
+		out = malloc(n, alignment);
+		if (out) Memory::memcpy(out, original, PlatformMath::min(n, oldSize));
 
 		// Free original with backup allocator
-		gMalloc->free(original);
+		backupMalloc->free(original);
 
 		return out;
 	}
@@ -112,58 +256,256 @@ void * MallocBinned::realloc(void * original, sizet n, uint32 alignment)
 
 void MallocBinned::free(void * original)
 {
-	// Use tree to quickly find pool
-	
-	// Search key
-	Pair<void*, MallocPool*> searchKey(original);
+	if (UNLIKELY(original == nullptr)) return;
 
-	PoolNodeRef it = root;
-	while (it)
+	// Use page map to quickly find pool
+	MallocPool * pool = findPool(original);
+	if (UNLIKELY(pool == nullptr))
 	{
-		if (searchKey < it->data)
-			it = it->left;
-		else
+		// Block was not alloc'd by pools
+		// Free using backup allocator
+		backupMalloc->free(original);
+		return;
+	}
+
+	const uint32 bucketIdx = getBucketIndex(pool->blockSize);
+	const uint32 cacheLimit = cacheLimits[bucketIdx];
+
+	ThreadCache * cache;
+	if (UNLIKELY(cacheLimit == 0) || UNLIKELY((cache = getCache()) == nullptr))
+	{
+		// Give back directly to pool, lock-free
+		pool->freeRemote(original);
+		return;
+	}
+
+	pushToBin(cache->bins[bucketIdx], original, cacheLimit);
+}
+
+void MallocBinned::freeSized(void * original, sizet n, uint32 alignment)
+{
+	if (UNLIKELY(original == nullptr)) return;
+
+	if (isBackupRequest(n, alignment))
+	{
+		backupMalloc->free(original);
+		return;
+	}
+
+	// The size can't select the bucket: realloc
+	// shrinks blocks in place, so it may belong
+	// to a smaller bucket than the block
+	free(original);
+}
+
+uint32 MallocBinned::mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment)
+{
+	if (isBackupRequest(n, alignment))
+		// Backup allocator has no batch path
+		return Malloc::mallocBatch(n, count, out, alignment);
+
+	// Bucket is found once for all blocks
+	const uint32 bucketIdx = UNLIKELY(alignment > MALLOC_BINNED_BLOCK_ALIGNMENT) ? getBucketIndex(n, alignment) : getBucketIndex(n);
+	const sizet blockSize = getBucketBlockSize(bucketIdx);
+
+	uint32 i = 0, nodeIdx = 0;
+	if (LIKELY(cacheLimits[bucketIdx] != 0))
+		if (ThreadCache * cache = getCache())
 		{
-			MallocPool * pool = it->data.second;
-			if (pool->hasBlock(original))
+			nodeIdx = cache->node;
+
+			// Empty cache bin first
+			ThreadCache::Bin & bin = cache->bins[bucketIdx];
+			for (; i < count && bin.head; ++i)
 			{
-				pool->free(original);
-				return;
+				out[i] = bin.head;
+				bin.head = *reinterpret_cast<void**>(bin.head);
+				bin.setCount(bin.count - 1);
 			}
-			else
-				it = it->right;
+		}
+
+	if (i < count)
+	{
+		if (UNLIKELY(cacheLimits[bucketIdx] == 0)) nodeIdx = getThreadNode();
+
+		ScopeLock bucketLock(&bucketsCS[nodeIdx][bucketIdx]);
+
+		// Take as many blocks as possible from each pool
+		while (i < count)
+		{
+			MallocPool * pool = findFreePool(bucketIdx, nodeIdx);
+			if (UNLIKELY(pool == nullptr)) break;
+
+			i += pool->mallocBatch(blockSize, count - i, out + i);
 		}
 	}
 
-	// Block was not alloc'd by pools
-	// Free using global allocator
-	gMalloc->free(original);
+	return i;
 }
 
-bool MallocBinned::getAllocSize(void * original, sizet & n)
+void MallocBinned::freeBatch(void ** originals, uint32 count)
 {
-	// Use tree to quickly find pool
-	
-	// Search key
-	Pair<void*, MallocPool*> searchKey(original);
+	// Pool of the current chain
+	MallocPool * pool = nullptr;
+	void * first = nullptr, * last = nullptr;
 
-	PoolNodeRef it = root;
-	while (it)
+	for (uint32 i = 0; i < count; ++i)
 	{
-		if (searchKey < it->data)
-			it = it->left;
+		void * block = originals[i];
+		if (UNLIKELY(block == nullptr)) continue;
+
+		MallocPool * owner = findPool(block);
+		if (UNLIKELY(owner == nullptr))
+			// Block was not alloc'd by pools
+			backupMalloc->free(block);
+		else if (owner == pool)
+		{
+			// Extend chain of the same pool
+			MallocPool::setNext(last, block);
+			last = block;
+		}
 		else
 		{
-			MallocPool * pool = it->data.second;
-			if (pool->hasBlock(original))
+			// Push previous chain to its pool
+			if (pool) pool->freeRemote(first, last);
+
+			pool = owner;
+			first = last = block;
+		}
+	}
+
+	if (pool) pool->freeRemote(first, last);
+}
+
+bool MallocBinned::getAllocSize(void * original, sizet & n)
+{
+	// Use page map to quickly find pool
+	if (MallocPool * pool = findPool(original))
+	{
+		n = pool->blockSize;
+		return true;
+	}
+
+	// Block was alloc'd by backup allocator
+	return backupMalloc->getAllocSize(original, n);
+}
+
+void MallocBinned::trim()
+{
+	// Other caches belong to running threads
+	if (ThreadCache * cache = reinterpret_cast<ThreadCache*>(PlatformTLS::getValue(cacheSlot)))
+		for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+			flushBin(cache->bins[i], cache->bins[i].count);
+
+	for (uint32 k = 0; k < MALLOC_BINNED_MAX_NODES; ++k)
+		for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+		{
+			ScopeLock bucketLock(&bucketsCS[k][i]);
+
+			uint32 numFreePools = 0;
+			PoolLinkRef next = buckets[k][i], it;
+			while ((it = next))
 			{
-				n = pool->blockSize;
-				return true;
+				next = it->next;
+
+				// Reclaim remotely freed blocks
+				MallocPool & pool = it->data;
+				pool.drainRemote();
+				if (!pool.isUnused()) continue;
+
+				// Keep a few free pools to avoid
+				// mapping them again right away
+				if (numFreePools >= numRetainedPools && releasePool(it, i, k)) continue;
+
+				pool.trim();
+				++numFreePools;
+			}
+		}
+
+	backupMalloc->trim();
+}
+
+void MallocBinned::getBucketStats(BucketStats (&stats)[MALLOC_BINNED_NUM_BUCKETS])
+{
+	for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+	{
+		stats[i] = BucketStats{};
+		stats[i].blockSize = getBucketBlockSize(i);
+
+		// Pools of all nodes
+		for (uint32 k = 0; k < MALLOC_BINNED_MAX_NODES; ++k)
+		{
+			ScopeLock bucketLock(&bucketsCS[k][i]);
+
+			for (PoolLinkRef it = buckets[k][i]; it; it = it->next)
+			{
+				MallocPool & pool = it->data;
+				pool.drainRemote();
+
+				++stats[i].numPools;
+				stats[i].numBlocks += pool.getNumBlocks();
+				stats[i].numFreeBlocks += pool.getNumFreeBlock();
+			}
+		}
+	}
+
+	// Bins are owned by other threads, counts are approximate
+	ScopeLock poolsLock(&poolsCS);
+
+	for (ThreadCache * cache = caches; cache; cache = cache->next)
+		for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+			stats[i].numCachedBlocks += PlatformAtomics::readRelaxed(&cache->bins[i].count);
+}
+
+bool MallocBinned::writeStats(FILE * out)
+{
+	BucketStats stats[MALLOC_BINNED_NUM_BUCKETS];
+	getBucketStats(stats);
+
+	fprintf(out, "{\"poolSize\":%llu,\"slotSize\":%llu,\"nodes\":%u,\"buckets\":[",
+		(unsigned long long)MALLOC_BINNED_POOL_SIZE,
+		(unsigned long long)MALLOC_BINNED_OCCUPANCY_SLOT_SIZE,
+		numNodes
+	);
+
+	const uint64 numSlots = MALLOC_BINNED_POOL_SIZE / MALLOC_BINNED_OCCUPANCY_SLOT_SIZE;
+	uint8 bitmap[numSlots / 8];
+
+	for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+	{
+		const BucketStats & bucket = stats[i];
+		fprintf(out, "%s{\"blockSize\":%llu,\"pools\":%llu,\"blocks\":%llu,\"free\":%llu,\"cached\":%llu,\"used\":%llu,\"occupancy\":%.4f,\"bitmaps\":[",
+			i ? "," : "",
+			(unsigned long long)bucket.blockSize,
+			(unsigned long long)bucket.numPools,
+			(unsigned long long)bucket.numBlocks,
+			(unsigned long long)bucket.numFreeBlocks,
+			(unsigned long long)bucket.numCachedBlocks,
+			(unsigned long long)bucket.getNumUsedBlocks(),
+			bucket.getOccupancy()
+		);
+
+		bool bFirst = true;
+		for (uint32 k = 0; k < MALLOC_BINNED_MAX_NODES; ++k)
+		{
+			ScopeLock bucketLock(&bucketsCS[k][i]);
+
+			for (PoolLinkRef it = buckets[k][i]; it; it = it->next)
+			{
+				Memory::memset(bitmap, 0, sizeof(bitmap));
+				if (!it->data.getOccupancy(bitmap, MALLOC_BINNED_OCCUPANCY_SLOT_SIZE)) continue;
+
+				// One digit per slot
+				fprintf(out, "%s\"", bFirst ? "" : ",");
+				for (uint64 j = 0, n = it->data.getNumSlots(MALLOC_BINNED_OCCUPANCY_SLOT_SIZE); j < n; ++j) fputc('0' + ((bitmap[j >> 3] >> (j & 7)) & 1), out);
+				fprintf(out, "\"");
+				bFirst = false;
 			}
-			else
-				it = it->right;
 		}
+
+		fprintf(out, "]}");
 	}
 
-	return false;
+	fprintf(out, "]}\n");
+	return true;
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "hal/malloc_linear.h"
+#include "hal/platform_math.h"
+
+MallocLinear::MallocLinear(sizet _frameSize, uint32 _numFrames, Malloc * _overflowMalloc) :
+	frames(nullptr),
+	numFrames(_numFrames),
+	frameIdx(0),
+	frameSize(PlatformMath::alignUp(_frameSize, PlatformMemory::getPageSize())),
+	overflowMalloc(_overflowMalloc ? _overflowMalloc : gMalloc),
+	last(nullptr)
+{
+	frames = reinterpret_cast<Frame*>(::calloc(numFrames, sizeof(Frame)));
+	if (UNLIKELY(frames == nullptr))
+	{
+		numFrames = 0;
+		return;
+	}
+
+	// Pages are committed on first use
+	for (uint32 i = 0; i < numFrames; ++i)
+	{
+		Frame & frame = frames[i];
+		frame.buffer = frame.curr = PlatformMemory::map(frameSize);
+		if (UNLIKELY(frame.buffer == nullptr))
+		{
+			// Overflow only, release frames mapped so far
+			for (uint32 j = 0; j < i; ++j)
+			{
+				PlatformMemory::unmap(frames[j].buffer, frameSize);
+				frames[j].buffer = frames[j].curr = nullptr;
+			}
+
+			frameSize = 0;
+			break;
+		}
+	}
+}
+
+MallocLinear::~MallocLinear()
+{
+	for (uint32 i = 0; i < numFrames; ++i)
+	{
+		freeOverflow(frames[i]);
+		if (frames[i].buffer) PlatformMemory::unmap(frames[i].buffer, frameSize);
+	}
+
+	::free(frames);
+}
+
+void MallocLinear::nextFrame()
+{
+	if (UNLIKELY(numFrames == 0)) return;
+
+	frameIdx = (frameIdx + 1) % numFrames;
+	last = nullptr;
+
+	// Reset frame buffer
+	Frame & frame = frames[frameIdx];
+	frame.curr = frame.buffer;
+	freeOverflow(frame);
+}
+
+void * MallocLinear::mallocOverflow(sizet n, uint32 alignment)
+{
+	// Block follows the header
+	alignment = PlatformMath::max<uint32>(alignment, alignof(OverflowHeader));
+	const sizet headerSize = PlatformMath::alignUp(sizeof(OverflowHeader), alignment);
+
+	void * buffer = overflowMalloc->malloc(headerSize + n, alignment);
+	if (UNLIKELY(buffer == nullptr)) return nullptr;
+
+	// Link in current frame
+	Frame & frame = frames[frameIdx];
+	OverflowHeader * header = reinterpret_cast<OverflowHeader*>(reinterpret_cast<uintP>(buffer) + headerSize) - 1;
+	header->next = frame.overflow;
+	header->buffer = buffer;
+	header->size = n;
+	frame.overflow = header;
+
+	return header + 1;
+}
+
+void MallocLinear::freeOverflow(Frame & frame)
+{
+	OverflowHeader * next = frame.overflow, * it;
+	while ((it = next))
+	{
+		next = it->next;
+		overflowMalloc->free(it->buffer);
+	}
+
+	frame.overflow = nullptr;
+}
+
+void * MallocLinear::malloc(sizet n, uint32 alignment)
+{
+	if (UNLIKELY(numFrames == 0)) return nullptr;
+
+	// Bump pointer
+	Frame & frame = frames[frameIdx];
+	const uintP out = PlatformMath::alignUp(reinterpret_cast<uintP>(frame.curr), alignment);
+	if (LIKELY(frame.buffer != nullptr) && out + n <= reinterpret_cast<uintP>(getFrameEnd(frame)))
+	{
+		frame.curr = reinterpret_cast<void*>(out + n);
+		return last = reinterpret_cast<void*>(out);
+	}
+
+	// Frame buffer is full
+	return last = mallocOverflow(n, alignment);
+}
+
+void * MallocLinear::realloc(void * original, sizet n, uint32 alignment)
+{
+	if (original == nullptr) return malloc(n, alignment);
+
+	sizet size;
+	if (Frame * frame = findFrame(original))
+	{
+		// Grow or shrink last block in place
+		if (original == last && frame == &frames[frameIdx] && (reinterpret_cast<uintP>(original) & (alignment - 1)) == 0
+			&& reinterpret_cast<uintP>(original) + n <= reinterpret_cast<uintP>(getFrameEnd(*frame)))
+		{
+			frame->curr = reinterpret_cast<void*>(reinterpret_cast<uintP>(original) + n);
+			return original;
+		}
+
+		// Block ends before the frame bump pointer
+		size = reinterpret_cast<uintP>(frame->curr) - reinterpret_cast<uintP>(original);
+	}
+	else
+		size = (reinterpret_cast<OverflowHeader*>(original) - 1)->size;
+
+	// Allocate new and copy memory
+	void * out = malloc(n, alignment);
+	if (out) Memory::memcpy(out, original, PlatformMath::min(n, size));
+
+	return out;
+}
+
+void MallocLinear::free(void * original)
+{
+	// Roll back last block
+	if (original && original == last && findFrame(original) == &frames[frameIdx])
+	{
+		frames[frameIdx].curr = original;
+		last = nullptr;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "hal/malloc_mapped.h"
+#include "hal/platform_math.h"
+
+void * MallocMapped::malloc(sizet n, uint32 alignment)
+{
+	// Header goes right before the block
+	const sizet offset = PlatformMath::alignUp(sizeof(Header), PlatformMath::max<sizet>(alignment, 16));
+	const sizet size = PlatformMath::alignUp(offset + n, PlatformMemory::getPageSize());
+
+	void * base = PlatformMemory::map(size, alignment, bHugePages);
+	if (UNLIKELY(base == nullptr)) return nullptr;
+
+	void * out = reinterpret_cast<void*>(reinterpret_cast<uintP>(base) + offset);
+	*getHeader(out) = Header{base, size};
+
+	return out;
+}
+
+void * MallocMapped::realloc(void * original, sizet n, uint32 alignment)
+{
+	if (original == nullptr) return malloc(n, alignment);
+	if (n == 0)
+	{
+		free(original);
+		return nullptr;
+	}
+
+	Header * header = getHeader(original);
+	const sizet offset = reinterpret_cast<uintP>(original) - reinterpret_cast<uintP>(header->base);
+	const sizet size = PlatformMath::alignUp(offset + n, PlatformMemory::getPageSize());
+
+	if (size <= header->size)
+	{
+		// Give back tail pages, shrinking never moves the mapping
+		if (size < header->size && PlatformMemory::remap(header->base, header->size, size))
+			header->size = size;
+
+		return original;
+	}
+
+	// Moved mappings keep the offset in the page
+	if (alignment <= PlatformMemory::getPageSize())
+	{
+		if (void * base = PlatformMemory::remap(header->base, header->size, size))
+		{
+			void * out = reinterpret_cast<void*>(reinterpret_cast<uintP>(base) + offset);
+			*getHeader(out) = Header{base, size};
+
+			return out;
+		}
+	}
+
+	// Allocate new and copy memory
+	void * out = malloc(n, alignment);
+	if (out) Memory::memcpy(out, original, header->size - offset);
+
+	free(original);
+	return out;
+}
+
+void MallocMapped::free(void * original)
+{
+	if (UNLIKELY(original == nullptr)) return;
+
+	Header * header = getHeader(original);
+	PlatformMemory::unmap(header->base, header->size);
+}
+
+bool MallocMapped::getAllocSize(void * original, sizet & n)
+{
+	if (!original) return false;
+
+	const Header * header = getHeader(original);
+	n = reinterpret_cast<uintP>(header->base) + header->size - reinterpret_cast<uintP>(original);
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "hal/platform_memory.h"
+#include "hal/platform_math.h"
+
+#if SGL_GMALLOC_OPERATORS
+
+#include <new>
+
+/**
+ * Global operator new and delete are replaced
+ * so that all objects are allocated by gMalloc.
+ * gMalloc is created on first use, objects may
+ * be allocated during static initialization
+ */
+namespace
+{
+	/// Returns global allocator, creates it if necessary
+	FORCE_INLINE Malloc * getGMalloc()
+	{
+		if (UNLIKELY(gMalloc == nullptr)) Memory::createGMalloc();
+		return gMalloc;
+	}
+
+	/// Allocates a block, null if out of memory
+	FORCE_INLINE void * mallocNoThrow(sizet n, uint32 alignment = DEFAULT_ALIGNMENT)
+	{
+		// Zero-sized objects have distinct addresses
+		return getGMalloc()->malloc(PlatformMath::max<sizet>(n, 1), PlatformMath::max<uint32>(alignment, DEFAULT_ALIGNMENT));
+	}
+
+	/// Allocates a block, throws if out of memory
+	FORCE_INLINE void * mallocOrThrow(sizet n, uint32 alignment = DEFAULT_ALIGNMENT)
+	{
+		void * out = mallocNoThrow(n, alignment);
+		if (UNLIKELY(out == nullptr)) throw std::bad_alloc();
+		return out;
+	}
+
+	/// Frees a block
+	FORCE_INLINE void freeBlock(void * original)
+	{
+		if (LIKELY(original != nullptr)) gMalloc->free(original);
+	}
+
+	/// Frees a block whose request is known
+	FORCE_INLINE void freeBlock(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT)
+	{
+		if (LIKELY(original != nullptr)) gMalloc->freeSized(original, PlatformMath::max<sizet>(n, 1), PlatformMath::max<uint32>(alignment, DEFAULT_ALIGNMENT));
+	}
+}
+
+void * operator new(std::size_t n) { return mallocOrThrow(n); }
+void * operator new[](std::size_t n) { return mallocOrThrow(n); }
+void * operator new(std::size_t n, const std::nothrow_t &) noexcept { return mallocNoThrow(n); }
+void * operator new[](std::size_t n, const std::nothrow_t &) noexcept { return mallocNoThrow(n); }
+
+void * operator new(std::size_t n, std::align_val_t alignment) { return mallocOrThrow(n, uint32(alignment)); }
+void * operator new[](std::size_t n, std::align_val_t alignment) { return mallocOrThrow(n, uint32(alignment)); }
+void * operator new(std::size_t n, std::align_val_t alignment, const std::nothrow_t &) noexcept { return mallocNoThrow(n, uint32(alignment)); }
+void * operator new[](std::size_t n, std::align_val_t alignment, const std::nothrow_t &) noexcept { return mallocNoThrow(n, uint32(alignment)); }
+
+void operator delete(void * original) noexcept { freeBlock(original); }
+void operator delete[](void * original) noexcept { freeBlock(original); }
+void operator delete(void * original, const std::nothrow_t &) noexcept { freeBlock(original); }
+void operator delete[](void * original, const std::nothrow_t &) noexcept { freeBlock(original); }
+
+void operator delete(void * original, std::size_t n) noexcept { freeBlock(original, n); }
+void operator delete[](void * original, std::size_t n) noexcept { freeBlock(original, n); }
+
+void operator delete(void * original, std::align_val_t) noexcept { freeBlock(original); }
+void operator delete[](void * original, std::align_val_t) noexcept { freeBlock(original); }
+void operator delete(void * original, std::align_val_t, const std::nothrow_t &) noexcept { freeBlock(original); }
+void operator delete[](void * original, std::align_val_t, const std::nothrow_t &) noexcept { freeBlock(original); }
+
+void operator delete(void * original, std::size_t n, std::align_val_t alignment) noexcept { freeBlock(original, n, uint32(alignment)); }
+void operator delete[](void * original, std::size_t n, std::align_val_t alignment) noexcept { freeBlock(original, n, uint32(alignment)); }
+
+#endif
\ No newline at end of file
@@ -2,44 +2,77 @@
 MallocPool::MallocPool(uint64 _numBlocks, sizet _blockSize, sizet blockAlignment, void * buffer) :
 	pool(buffer),
 	bHasOwnBuffer(buffer == nullptr),
-	numBlocks(_numBlocks),
+	remoteHead(nullptr),
 	blockSize(_blockSize),
-	numFreeBlocks(numBlocks)
+	chunkSize(PlatformMath::alignUp(PlatformMath::max(sizet(sizeof(void*)), _blockSize), blockAlignment)),
+	numBlocks(_numBlocks),
+	numFreeBlocks(_numBlocks)
 {
-	const sizet
-		descriptorSize	= sizeof(void*),
-		chunkSize		= PlatformMath::alignUp(descriptorSize + blockSize, blockAlignment),
-		poolSize		= blockAlignment + chunkSize * numBlocks;
+	const sizet poolSize = chunkSize * numBlocks;
+
+	// Free list is empty
+	head = nullptr;
 
 	// Allocate pool
 	if (bHasOwnBuffer)
 	{
-		if (posix_memalign(&pool, blockAlignment, poolSize)) return;
+		if (posix_memalign(&pool, blockAlignment, poolSize))
+		{
+			// Pool is exhausted
+			bump = bumpEnd = end = pool = nullptr;
+			numFreeBlocks = 0;
+			return;
+		}
 	}
 
-	// Padding for aligned blocks
-	head = setOffset(pool, blockAlignment - descriptorSize);
 	// Set pool end address
-	end = reinterpret_cast<void*>(reinterpret_cast<uint64>(pool) + poolSize);
+	bump = pool;
+	bumpEnd = end = reinterpret_cast<void*>(reinterpret_cast<uint64>(pool) + poolSize);
+}
 
-	// Init linked list
-	for (uint64 b = 0; b < numBlocks - 1; ++b)
-		head = setOffset(head, chunkSize);
-	
-	// Set last as nullptr
-	setNext(head, nullptr);
-	
-	// Reset head
-	head = getNext(pool);
+bool MallocPool::drainRemote()
+{
+	// Avoid atomic exchange if empty
+	if (PlatformAtomics::readRelaxed(&remoteHead) == nullptr) return false;
+
+	// Steal the whole remote list
+	void * remote = PlatformAtomics::exchange(&remoteHead, (void*)nullptr);
+	if (remote == nullptr) return false;
+
+	// Count blocks and find tail
+	void * tail = remote;
+	uint64 numRemoteBlocks = 1;
+	for (void * next; (next = getNext(tail)); tail = next) ++numRemoteBlocks;
+
+	// Prepend to free list
+	setNext(tail, head);
+	head = remote;
+	numFreeBlocks += numRemoteBlocks;
+
+	return true;
 }
 
 void * MallocPool::malloc(sizet n, uint32 alignment)
 {
-	// Pool empty
-	if (head == nullptr | n > blockSize) return nullptr;
+	// Block too small or not aligned enough
+	if (n > blockSize || alignment > getBlockAlignment()) return nullptr;
 
-	void * out = getBlock(head);
-	head = getNext(head);
+	void * out;
+	if (LIKELY(head != nullptr) || drainRemote())
+	{
+		// Recycle a free block
+		out = head;
+		head = getNext(head);
+	}
+	else if (bump < bumpEnd)
+	{
+		// Use a block for the first time
+		out = bump;
+		bump = reinterpret_cast<void*>(reinterpret_cast<uint64>(bump) + chunkSize);
+	}
+	else
+		// Pool empty
+		return nullptr;
 
 	--numFreeBlocks;
 	return out;
@@ -47,8 +80,10 @@ void * MallocPool::malloc(sizet n, uint32 alignment)
 
 void * MallocPool::realloc(void * original, sizet n, uint32 alignment)
 {
+	if (original == nullptr) return malloc(n, alignment);
+
 	// We cannot really realloc
-	if (n > blockSize)
+	if (n > blockSize || alignment > getBlockAlignment())
 		return nullptr;
 	else
 		return original;
@@ -57,13 +92,59 @@ void * MallocPool::realloc(void * original, sizet n, uint32 alignment)
 void MallocPool::free(void * original)
 {
 	// Relink in free list
-	original = getDescriptor(original);
-	setNext(original, (void**)head);
+	setNext(original, head);
 	
 	++numFreeBlocks;
 	head = original;
 }
 
+uint32 MallocPool::mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment)
+{
+	// Block too small or not aligned enough
+	if (n > blockSize || alignment > getBlockAlignment()) return 0;
+
+	uint32 i = 0;
+	while (i < count)
+	{
+		if (head != nullptr || drainRemote())
+		{
+			// Recycle free blocks
+			for (; i < count && head; ++i)
+			{
+				out[i] = head;
+				head = getNext(head);
+			}
+		}
+		else if (bump < bumpEnd)
+		{
+			// Use blocks for the first time
+			for (; i < count && bump < bumpEnd; ++i)
+			{
+				out[i] = bump;
+				bump = reinterpret_cast<void*>(reinterpret_cast<uint64>(bump) + chunkSize);
+			}
+		}
+		else
+			// Pool empty
+			break;
+	}
+
+	numFreeBlocks -= i;
+	return i;
+}
+
+void MallocPool::freeBatch(void ** originals, uint32 count)
+{
+	if (count == 0) return;
+
+	// Chain blocks and splice chain
+	for (uint32 i = 1; i < count; ++i) setNext(originals[i - 1], originals[i]);
+	setNext(originals[count - 1], head);
+
+	head = originals[0];
+	numFreeBlocks += count;
+}
+
 bool MallocPool::getAllocSize(void * original, sizet & n)
 {
 	if (hasBlock(original))
@@ -73,4 +154,50 @@ bool MallocPool::getAllocSize(void * original, sizet & n)
 	}
 	
 	return false;
+}
+
+void MallocPool::trim()
+{
+	drainRemote();
+
+	// Some blocks in use or never used at all
+	if (!isUnused() || bump == pool) return;
+
+	// Decommit whole pages only, the buffer
+	// may share its first and last page
+	const sizet pageSize = PlatformMemory::getPageSize();
+	const uint64 first = PlatformMath::alignUp(reinterpret_cast<uint64>(pool), pageSize);
+	const uint64 last = reinterpret_cast<uint64>(bump) & ~(pageSize - 1);
+	if (first < last) PlatformMemory::decommit(reinterpret_cast<void*>(first), last - first);
+
+	// Back to lazy state
+	head = nullptr;
+	bump = pool;
+}
+
+bool MallocPool::getOccupancy(uint8 * bitmap, sizet slotSize) const
+{
+	const uint64 numSlots = getNumSlots(slotSize);
+	const uintP base = reinterpret_cast<uintP>(pool);
+
+	// Count blocks and free blocks of each slot
+	uint32 * counts = reinterpret_cast<uint32*>(::calloc(2 * numSlots, sizeof(uint32)));
+	if (UNLIKELY(counts == nullptr)) return false;
+
+	uint32 * numSlotBlocks = counts, * numSlotFreeBlocks = counts + numSlots;
+	for (uint64 i = 0; i < numBlocks; ++i)
+		++numSlotBlocks[i * chunkSize / slotSize];
+
+	for (void * it = head; it; it = getNext(it))
+		++numSlotFreeBlocks[(reinterpret_cast<uintP>(it) - base) / slotSize];
+
+	// Blocks past the bump pointer were never used
+	for (uintP it = reinterpret_cast<uintP>(bump); it < reinterpret_cast<uintP>(bumpEnd); it += chunkSize)
+		++numSlotFreeBlocks[(it - base) / slotSize];
+
+	for (uint64 i = 0; i < numSlots; ++i)
+		if (numSlotBlocks[i] > numSlotFreeBlocks[i]) bitmap[i >> 3] |= 1 << (i & 7);
+
+	::free(counts);
+	return true;
 }
\ No newline at end of file
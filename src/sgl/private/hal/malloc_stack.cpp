@@ -0,0 +1,130 @@
+#include "hal/malloc_stack.h"
+#include "hal/platform_math.h"
+
+MallocStack::MallocStack(sizet size, Malloc * _overflowMalloc) :
+	buffer(nullptr),
+	curr(nullptr),
+	end(nullptr),
+	overflow(nullptr),
+	overflowMalloc(_overflowMalloc ? _overflowMalloc : gMalloc),
+	last(nullptr)
+{
+	// Pages are committed on first use
+	size = PlatformMath::alignUp(size, PlatformMemory::getPageSize());
+	if ((buffer = PlatformMemory::map(size)))
+	{
+		curr = buffer;
+		end = reinterpret_cast<void*>(reinterpret_cast<uintP>(buffer) + size);
+	}
+}
+
+MallocStack::~MallocStack()
+{
+	popToMarker(Marker{buffer, nullptr});
+	if (buffer) PlatformMemory::unmap(buffer, reinterpret_cast<uintP>(end) - reinterpret_cast<uintP>(buffer));
+}
+
+MallocStack * MallocStack::get()
+{
+	// Slot is created once, stacks are deleted on thread exit
+	static const uint32 slot = PlatformTLS::allocateSlot(&MallocStack::destroyThreadStack);
+
+	MallocStack * stack = reinterpret_cast<MallocStack*>(PlatformTLS::getValue(slot));
+	if (UNLIKELY(stack == nullptr))
+	{
+		stack = new MallocStack(MALLOC_STACK_THREAD_SIZE);
+		PlatformTLS::setValue(slot, stack);
+	}
+
+	return stack;
+}
+
+void MallocStack::destroyThreadStack(void * stack)
+{
+	delete reinterpret_cast<MallocStack*>(stack);
+}
+
+void MallocStack::popToMarker(const Marker & marker)
+{
+	// Free overflow blocks allocated after marker
+	while (overflow != marker.overflow)
+	{
+		OverflowHeader * prev = overflow->prev;
+		overflowMalloc->free(overflow->buffer);
+		overflow = prev;
+	}
+
+	curr = marker.curr;
+	last = nullptr;
+}
+
+void * MallocStack::mallocOverflow(sizet n, uint32 alignment)
+{
+	// Block follows the header
+	alignment = PlatformMath::max<uint32>(alignment, alignof(OverflowHeader));
+	const sizet headerSize = PlatformMath::alignUp(sizeof(OverflowHeader), alignment);
+
+	void * base = overflowMalloc->malloc(headerSize + n, alignment);
+	if (UNLIKELY(base == nullptr)) return nullptr;
+
+	// Push on overflow list
+	OverflowHeader * header = reinterpret_cast<OverflowHeader*>(reinterpret_cast<uintP>(base) + headerSize) - 1;
+	header->prev = overflow;
+	header->buffer = base;
+	header->size = n;
+	overflow = header;
+
+	return header + 1;
+}
+
+void * MallocStack::malloc(sizet n, uint32 alignment)
+{
+	// Bump pointer
+	const uintP out = PlatformMath::alignUp(reinterpret_cast<uintP>(curr), alignment);
+	if (LIKELY(buffer != nullptr) && out + n <= reinterpret_cast<uintP>(end))
+	{
+		curr = reinterpret_cast<void*>(out + n);
+		return last = reinterpret_cast<void*>(out);
+	}
+
+	// Stack is full
+	return last = mallocOverflow(n, alignment);
+}
+
+void * MallocStack::realloc(void * original, sizet n, uint32 alignment)
+{
+	if (original == nullptr) return malloc(n, alignment);
+
+	sizet size;
+	if (hasBlock(original))
+	{
+		// Grow or shrink last block in place
+		if (original == last && (reinterpret_cast<uintP>(original) & (alignment - 1)) == 0
+			&& reinterpret_cast<uintP>(original) + n <= reinterpret_cast<uintP>(end))
+		{
+			curr = reinterpret_cast<void*>(reinterpret_cast<uintP>(original) + n);
+			return original;
+		}
+
+		// Block ends before the bump pointer
+		size = reinterpret_cast<uintP>(curr) - reinterpret_cast<uintP>(original);
+	}
+	else
+		size = (reinterpret_cast<OverflowHeader*>(original) - 1)->size;
+
+	// Allocate new and copy memory
+	void * out = malloc(n, alignment);
+	if (out) Memory::memcpy(out, original, PlatformMath::min(n, size));
+
+	return out;
+}
+
+void MallocStack::free(void * original)
+{
+	// Roll back last block
+	if (original && original == last && hasBlock(original))
+	{
+		curr = original;
+		last = nullptr;
+	}
+}
\ No newline at end of file
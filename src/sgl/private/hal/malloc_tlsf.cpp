@@ -0,0 +1,325 @@
+#include "hal/malloc_tlsf.h"
+
+MallocTLSF::MallocTLSF(sizet _areaSize) :
+	flBitmap(0),
+	slBitmaps{},
+	areas(nullptr),
+	areaSize(_areaSize)
+{
+	// Empty lists point to sentinel
+	nullBlock.nextFree = nullBlock.prevFree = &nullBlock;
+	for (uint32 i = 0; i < flIndexCount; ++i)
+		for (uint32 j = 0; j < slIndexCount; ++j)
+			blocks[i][j] = &nullBlock;
+
+	// Map first area up front
+	addArea(0);
+}
+
+MallocTLSF::~MallocTLSF()
+{
+	Area * next = areas, * it;
+	while ((it = next))
+	{
+		next = it->next;
+		PlatformMemory::unmap(it, it->size);
+	}
+}
+
+MallocTLSF::BlockHeader * MallocTLSF::searchSuitableBlock(uint32 & fl, uint32 & sl)
+{
+	// Search in lists of same first level
+	uint32 slMap = slBitmaps[fl] & (~0U << sl);
+	if (!slMap)
+	{
+		// Search in next non-empty first level
+		const uint64 flMap = flBitmap & (~0ULL << (fl + 1));
+		if (!flMap) return nullptr;
+
+		fl = PlatformMath::getTrailingZeros(flMap);
+		slMap = slBitmaps[fl];
+	}
+
+	sl = PlatformMath::getTrailingZeros(slMap);
+	return blocks[fl][sl];
+}
+
+void MallocTLSF::removeFreeBlock(BlockHeader * block, uint32 fl, uint32 sl)
+{
+	BlockHeader * prev = block->prevFree;
+	BlockHeader * next = block->nextFree;
+	next->prevFree = prev;
+	prev->nextFree = next;
+
+	// Update head and bitmaps
+	if (blocks[fl][sl] == block)
+	{
+		blocks[fl][sl] = next;
+		if (next == &nullBlock)
+		{
+			slBitmaps[fl] &= ~(1U << sl);
+			if (!slBitmaps[fl]) flBitmap &= ~(1ULL << fl);
+		}
+	}
+}
+
+void MallocTLSF::insertFreeBlock(BlockHeader * block, uint32 fl, uint32 sl)
+{
+	BlockHeader * curr = blocks[fl][sl];
+	block->nextFree = curr;
+	block->prevFree = &nullBlock;
+	curr->prevFree = block;
+
+	blocks[fl][sl] = block;
+	flBitmap |= 1ULL << fl;
+	slBitmaps[fl] |= 1U << sl;
+}
+
+void MallocTLSF::removeBlock(BlockHeader * block)
+{
+	uint32 fl, sl;
+	mappingInsert(block->getSize(), fl, sl);
+	removeFreeBlock(block, fl, sl);
+}
+
+void MallocTLSF::insertBlock(BlockHeader * block)
+{
+	uint32 fl, sl;
+	mappingInsert(block->getSize(), fl, sl);
+	insertFreeBlock(block, fl, sl);
+}
+
+MallocTLSF::BlockHeader * MallocTLSF::splitBlock(BlockHeader * block, sizet n)
+{
+	// Remaining block starts right after the payload
+	BlockHeader * remaining = offsetToBlock(getPtr(block), n - blockHeaderOverhead);
+	const sizet remainingSize = block->getSize() - (n + blockHeaderOverhead);
+
+	remaining->setSize(remainingSize);
+	block->setSize(n);
+	markAsFree(remaining);
+
+	return remaining;
+}
+
+MallocTLSF::BlockHeader * MallocTLSF::absorbBlock(BlockHeader * prev, BlockHeader * block)
+{
+	// Flags of prev are kept
+	prev->size += block->getSize() + blockHeaderOverhead;
+	linkNextBlock(prev);
+
+	return prev;
+}
+
+MallocTLSF::BlockHeader * MallocTLSF::mergePrevBlock(BlockHeader * block)
+{
+	if (block->isPrevFree())
+	{
+		BlockHeader * prev = block->prevPhys;
+		removeBlock(prev);
+		block = absorbBlock(prev, block);
+	}
+
+	return block;
+}
+
+MallocTLSF::BlockHeader * MallocTLSF::mergeNextBlock(BlockHeader * block)
+{
+	BlockHeader * next = getNextBlock(block);
+	if (next->isFree())
+	{
+		removeBlock(next);
+		block = absorbBlock(block, next);
+	}
+
+	return block;
+}
+
+void MallocTLSF::trimFreeBlock(BlockHeader * block, sizet n)
+{
+	if (block->getSize() >= sizeof(BlockHeader) + n)
+	{
+		BlockHeader * remaining = splitBlock(block, n);
+		linkNextBlock(block);
+		remaining->setPrevFree();
+		insertBlock(remaining);
+	}
+}
+
+void MallocTLSF::trimUsedBlock(BlockHeader * block, sizet n)
+{
+	if (block->getSize() >= sizeof(BlockHeader) + n)
+	{
+		// Remaining block may merge with next block
+		BlockHeader * remaining = splitBlock(block, n);
+		remaining->setPrevUsed();
+		remaining = mergeNextBlock(remaining);
+		insertBlock(remaining);
+	}
+}
+
+MallocTLSF::BlockHeader * MallocTLSF::trimFreeLeadingBlock(BlockHeader * block, sizet n)
+{
+	BlockHeader * remaining = block;
+	if (block->getSize() >= sizeof(BlockHeader) + n)
+	{
+		// Leading block goes back to free lists
+		remaining = splitBlock(block, n - blockHeaderOverhead);
+		remaining->setPrevFree();
+		linkNextBlock(block);
+		insertBlock(block);
+	}
+
+	return remaining;
+}
+
+MallocTLSF::BlockHeader * MallocTLSF::locateFreeBlock(sizet n)
+{
+	uint32 fl, sl;
+	mappingSearch(n, fl, sl);
+	if (UNLIKELY(fl >= flIndexCount)) return nullptr;
+
+	BlockHeader * block = searchSuitableBlock(fl, sl);
+	if (block == nullptr) return nullptr;
+
+	removeFreeBlock(block, fl, sl);
+	return block;
+}
+
+bool MallocTLSF::addArea(sizet n)
+{
+	/**
+	 * Area layout. The prev pointer of the first
+	 * block lies in the area header, it is never used.
+	 * The last block is an empty used sentinel
+	 *  Area     Free block           Sentinel
+	 * |--------|--------------------|--------|
+	 */
+	const sizet minSize = sizeof(Area) + 2 * blockHeaderOverhead + sizeof(BlockHeader) + n + (n >> (slIndexCountLog2 - 1));
+	const sizet size = PlatformMath::alignUp(PlatformMath::max(areaSize, minSize), PlatformMemory::getPageSize());
+
+	Area * area = reinterpret_cast<Area*>(PlatformMemory::map(size));
+	if (UNLIKELY(area == nullptr)) return false;
+
+	area->size = size;
+	area->next = areas;
+	areas = area;
+
+	// Create a single free block
+	const sizet blockSize = (size - sizeof(Area) - 2 * blockHeaderOverhead) & ~(alignSize - 1);
+	BlockHeader * block = offsetToBlock(area + 1, -intP(blockHeaderOverhead));
+	block->size = blockSize;
+	block->setFree();
+	block->setPrevUsed();
+	insertBlock(block);
+
+	// Create sentinel
+	BlockHeader * sentinel = linkNextBlock(block);
+	sentinel->size = 0;
+	sentinel->setUsed();
+	sentinel->setPrevFree();
+
+	return true;
+}
+
+void * MallocTLSF::malloc(sizet n, uint32 alignment)
+{
+	const sizet size = adjustRequestSize(n, alignSize);
+	if (UNLIKELY(size == 0)) return nullptr;
+
+	ScopeLock lock(&cs);
+
+	// Leave room for a leading free block
+	const bool bOverAligned = alignment > alignSize;
+	const sizet searchSize = bOverAligned ? adjustRequestSize(size + alignment + sizeof(BlockHeader), alignSize) : size;
+
+	BlockHeader * block = locateFreeBlock(searchSize);
+	if (UNLIKELY(block == nullptr) && (!addArea(searchSize) || (block = locateFreeBlock(searchSize)) == nullptr))
+		return nullptr;
+
+	if (UNLIKELY(bOverAligned))
+	{
+		const uintP ptr = reinterpret_cast<uintP>(getPtr(block));
+		uintP aligned = PlatformMath::alignUp(ptr, alignment);
+		sizet gap = aligned - ptr;
+
+		// Gap must fit a free block header
+		if (gap && gap < sizeof(BlockHeader))
+		{
+			aligned = PlatformMath::alignUp(aligned + PlatformMath::max<sizet>(sizeof(BlockHeader) - gap, alignment), alignment);
+			gap = aligned - ptr;
+		}
+
+		if (gap) block = trimFreeLeadingBlock(block, gap);
+	}
+
+	trimFreeBlock(block, size);
+	markAsUsed(block);
+
+	return getPtr(block);
+}
+
+void * MallocTLSF::realloc(void * original, sizet n, uint32 alignment)
+{
+	if (original == nullptr) return malloc(n, alignment);
+	if (n == 0)
+	{
+		free(original);
+		return nullptr;
+	}
+
+	const sizet size = adjustRequestSize(n, alignSize);
+	if (UNLIKELY(size == 0)) return nullptr;
+
+	ScopeLock lock(&cs);
+
+	BlockHeader * block = getBlock(original);
+	BlockHeader * next = getNextBlock(block);
+	const sizet currSize = block->getSize();
+	const sizet combinedSize = currSize + next->getSize() + blockHeaderOverhead;
+
+	if ((reinterpret_cast<uintP>(original) & (alignment - 1)) == 0 && (size <= currSize || (next->isFree() && size <= combinedSize)))
+	{
+		// Grow into next block or shrink in place
+		if (size > currSize)
+		{
+			mergeNextBlock(block);
+			markAsUsed(block);
+		}
+
+		trimUsedBlock(block, size);
+		return original;
+	}
+
+	// Allocate new and copy memory, lock is recursive
+	void * out = malloc(n, alignment);
+	if (out)
+	{
+		Memory::memcpy(out, original, PlatformMath::min(currSize, n));
+		free(original);
+	}
+
+	return out;
+}
+
+void MallocTLSF::free(void * original)
+{
+	if (UNLIKELY(original == nullptr)) return;
+
+	ScopeLock lock(&cs);
+
+	// Merge with neighbours and reinsert
+	BlockHeader * block = getBlock(original);
+	markAsFree(block);
+	block = mergePrevBlock(block);
+	block = mergeNextBlock(block);
+	insertBlock(block);
+}
+
+bool MallocTLSF::getAllocSize(void * original, sizet & n)
+{
+	if (!original) return false;
+
+	n = getBlock(original)->getSize();
+	return true;
+}
\ No newline at end of file
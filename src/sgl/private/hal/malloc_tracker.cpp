@@ -0,0 +1,267 @@
+#include "hal/malloc_tracker.h"
+#include "hal/platform_math.h"
+#include "hal/platform_string.h"
+
+namespace
+{
+	/// Registered tag names, tag 0 is untagged
+	const char * tagNames[MALLOC_TRACKER_MAX_TAGS] = {"Untagged"};
+	volatile uint32 numTags = 1;
+
+	/// Lock for tag registration
+	CriticalSection & getTagsCS()
+	{
+		static CriticalSection tagsCS;
+		return tagsCS;
+	}
+}
+
+MallocTracker::MallocTracker(Malloc * _innerMalloc) :
+	innerMalloc(_innerMalloc ? _innerMalloc : gMalloc),
+	stats{} {}
+
+uint32 MallocTracker::getTagSlot()
+{
+	// Slot is created once, untagged by default
+	static const uint32 slot = PlatformTLS::allocateSlot();
+	return slot;
+}
+
+uint32 MallocTracker::registerTag(const char * name)
+{
+	ScopeLock lock(&getTagsCS());
+
+	for (uint32 i = 0; i < numTags; ++i)
+		if (tagNames[i] == name || PlatformString::strcmp(tagNames[i], name) == 0) return i;
+
+	if (UNLIKELY(numTags == MALLOC_TRACKER_MAX_TAGS)) return 0;
+
+	tagNames[numTags] = name;
+	return PlatformAtomics::increment(&numTags);
+}
+
+const char * MallocTracker::getTagName(uint32 tag)
+{
+	return tag < getNumTags() ? tagNames[tag] : nullptr;
+}
+
+uint32 MallocTracker::getNumTags()
+{
+	return PlatformAtomics::read(&numTags);
+}
+
+void MallocTracker::addBytes(TagStats & tagStats, int64 n)
+{
+	const uint64 currBytes = PlatformAtomics::add(&tagStats.currBytes, n) + n;
+
+	// Raise peak if necessary
+	uint64 peakBytes = PlatformAtomics::readRelaxed(&tagStats.peakBytes);
+	while (peakBytes < currBytes)
+	{
+		const uint64 prevBytes = PlatformAtomics::compareExchange(&tagStats.peakBytes, peakBytes, currBytes);
+		if (prevBytes == peakBytes) break;
+		peakBytes = prevBytes;
+	}
+}
+
+void MallocTracker::trackAlloc(uint32 tag, sizet n, uint32 count)
+{
+	TagStats & tagStats = stats[tag];
+	PlatformAtomics::add(&tagStats.numAllocs, count);
+	PlatformAtomics::add(&tagStats.histogram[getHistogramBin(n)], count);
+	addBytes(tagStats, int64(n * count));
+}
+
+void MallocTracker::trackRealloc(uint32 tag, sizet prevN, sizet n)
+{
+	addBytes(stats[tag], int64(n) - int64(prevN));
+}
+
+void MallocTracker::trackFree(uint32 tag, sizet n)
+{
+	TagStats & tagStats = stats[tag];
+	PlatformAtomics::increment(&tagStats.numFrees);
+	PlatformAtomics::add(&tagStats.currBytes, -int64(n));
+}
+
+MallocTracker::TagStats MallocTracker::getTagStats(uint32 tag) const
+{
+	TagStats out{};
+	if (tag >= MALLOC_TRACKER_MAX_TAGS) return out;
+
+	// Counters are read one by one
+	const TagStats & tagStats = stats[tag];
+	out.numAllocs = PlatformAtomics::read(&tagStats.numAllocs);
+	out.numFrees = PlatformAtomics::read(&tagStats.numFrees);
+	out.currBytes = PlatformAtomics::read(&tagStats.currBytes);
+	out.peakBytes = PlatformAtomics::read(&tagStats.peakBytes);
+	for (uint32 i = 0; i < MALLOC_TRACKER_HISTOGRAM_BINS; ++i)
+		out.histogram[i] = PlatformAtomics::read(&tagStats.histogram[i]);
+
+	return out;
+}
+
+void MallocTracker::dumpReport(FILE * out) const
+{
+	fprintf(out, "%-32s %12s %12s %14s %14s  %s\n", "tag", "allocs", "frees", "live Bytes", "peak Bytes", "sizes (log2: count)");
+
+	const uint32 n = getNumTags();
+	for (uint32 i = 0; i < n; ++i)
+	{
+		const TagStats tagStats = getTagStats(i);
+		if (tagStats.numAllocs == 0) continue;
+
+		fprintf(out, "%-32s %12llu %12llu %14llu %14llu ",
+			tagNames[i],
+			(unsigned long long)tagStats.numAllocs,
+			(unsigned long long)tagStats.numFrees,
+			(unsigned long long)tagStats.currBytes,
+			(unsigned long long)tagStats.peakBytes
+		);
+
+		for (uint32 j = 0; j < MALLOC_TRACKER_HISTOGRAM_BINS; ++j)
+			if (tagStats.histogram[j]) fprintf(out, " %u:%llu", j, (unsigned long long)tagStats.histogram[j]);
+
+		fprintf(out, "\n");
+	}
+}
+
+void * MallocTracker::malloc(sizet n, uint32 alignment)
+{
+	// Header goes right before the block
+	alignment = PlatformMath::max<uint32>(alignment, alignof(Header));
+	const sizet offset = getOffset(alignment);
+
+	void * base = innerMalloc->malloc(offset + n, alignment);
+	if (UNLIKELY(base == nullptr)) return nullptr;
+
+	const uint32 tag = getCurrentTag();
+	void * out = reinterpret_cast<void*>(reinterpret_cast<uintP>(base) + offset);
+	*getHeader(out) = Header{tag, uint32(offset), n};
+
+	trackAlloc(tag, n);
+	return out;
+}
+
+void * MallocTracker::realloc(void * original, sizet n, uint32 alignment)
+{
+	if (original == nullptr) return malloc(n, alignment);
+	if (n == 0)
+	{
+		free(original);
+		return nullptr;
+	}
+
+	alignment = PlatformMath::max<uint32>(alignment, alignof(Header));
+	const Header header = *getHeader(original);
+	void * base = reinterpret_cast<void*>(reinterpret_cast<uintP>(original) - header.offset);
+	void * out;
+
+	if (header.offset == getOffset(alignment))
+	{
+		// Same layout, let inner allocator resize
+		if (UNLIKELY((base = innerMalloc->realloc(base, header.offset + n, alignment)) == nullptr)) return nullptr;
+		out = reinterpret_cast<void*>(reinterpret_cast<uintP>(base) + header.offset);
+	}
+	else
+	{
+		// Layout changes, allocate new and copy
+		const sizet offset = getOffset(alignment);
+		void * newBase = innerMalloc->malloc(offset + n, alignment);
+		if (UNLIKELY(newBase == nullptr)) return nullptr;
+
+		out = reinterpret_cast<void*>(reinterpret_cast<uintP>(newBase) + offset);
+		Memory::memcpy(out, original, PlatformMath::min(header.size, n));
+		innerMalloc->free(base);
+	}
+
+	// Block keeps its tag
+	*getHeader(out) = Header{header.tag, uint32(getOffset(alignment)), n};
+
+	trackRealloc(header.tag, header.size, n);
+	return out;
+}
+
+void MallocTracker::free(void * original)
+{
+	if (UNLIKELY(original == nullptr)) return;
+
+	const Header header = *getHeader(original);
+	trackFree(header.tag, header.size);
+
+	innerMalloc->free(reinterpret_cast<void*>(reinterpret_cast<uintP>(original) - header.offset));
+}
+
+void MallocTracker::freeSized(void * original, sizet n, uint32 alignment)
+{
+	if (UNLIKELY(original == nullptr)) return;
+
+	// Inner block was requested with header
+	const Header header = *getHeader(original);
+	trackFree(header.tag, header.size);
+
+	innerMalloc->freeSized(reinterpret_cast<void*>(reinterpret_cast<uintP>(original) - header.offset), header.offset + header.size, PlatformMath::max<uint32>(alignment, alignof(Header)));
+}
+
+uint32 MallocTracker::mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment)
+{
+	alignment = PlatformMath::max<uint32>(alignment, alignof(Header));
+	const sizet offset = getOffset(alignment);
+
+	const uint32 numAllocated = innerMalloc->mallocBatch(offset + n, count, out, alignment);
+	if (UNLIKELY(numAllocated == 0)) return 0;
+
+	const uint32 tag = getCurrentTag();
+	for (uint32 i = 0; i < numAllocated; ++i)
+	{
+		out[i] = reinterpret_cast<void*>(reinterpret_cast<uintP>(out[i]) + offset);
+		*getHeader(out[i]) = Header{tag, uint32(offset), n};
+	}
+
+	trackAlloc(tag, n, numAllocated);
+	return numAllocated;
+}
+
+void MallocTracker::freeBatch(void ** originals, uint32 count)
+{
+	// Translate to inner blocks in chunks,
+	// originals are not modified and null
+	// entries are skipped
+	void * bases[64];
+	uint32 n = 0;
+
+	for (uint32 i = 0; i < count; ++i)
+	{
+		if (!originals[i]) continue;
+
+		const Header header = *getHeader(originals[i]);
+		trackFree(header.tag, header.size);
+
+		bases[n++] = reinterpret_cast<void*>(reinterpret_cast<uintP>(originals[i]) - header.offset);
+		if (n == 64)
+		{
+			innerMalloc->freeBatch(bases, n);
+			n = 0;
+		}
+	}
+
+	if (n > 0) innerMalloc->freeBatch(bases, n);
+}
+
+bool MallocTracker::getAllocSize(void * original, sizet & n)
+{
+	if (!original) return false;
+
+	n = getHeader(original)->size;
+	return true;
+}
+
+void MallocTracker::trim()
+{
+	innerMalloc->trim();
+}
+
+bool MallocTracker::writeStats(FILE * out)
+{
+	return innerMalloc->writeStats(out);
+}
\ No newline at end of file
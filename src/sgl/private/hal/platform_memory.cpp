@@ -1,8 +1,55 @@
 #include "hal/platform_memory.h"
 #include "hal/platform_math.h"
 
+#if SGL_GMALLOC_BINNED
+	#include "hal/malloc_binned.h"
+#elif SGL_GMALLOC_TLSF
+	#include "hal/malloc_tlsf.h"
+#endif
+#if SGL_MALLOC_TRACKER
+	#include "hal/malloc_tracker.h"
+#endif
+
+namespace
+{
+	/**
+	 * Global allocators live in static storage and
+	 * are never destroyed: they don't depend on
+	 * operator new, which may route to gMalloc, and
+	 * blocks can be freed during static destruction
+	 */
+#if SGL_GMALLOC_BINNED
+	alignas(MallocBinned) uint8 gMallocStorage[sizeof(MallocBinned)];
+#elif SGL_GMALLOC_TLSF
+	alignas(MallocTLSF) uint8 gMallocStorage[sizeof(MallocTLSF)];
+#endif
+#if SGL_MALLOC_TRACKER
+	alignas(MallocTracker) uint8 gMallocTrackerStorage[sizeof(MallocTracker)];
+#endif
+
+	Malloc * constructGMalloc()
+	{
+	#if SGL_GMALLOC_BINNED
+		Malloc * malloc = new (gMallocStorage) MallocBinned;
+	#elif SGL_GMALLOC_TLSF
+		Malloc * malloc = new (gMallocStorage) MallocTLSF;
+	#else
+		Malloc * malloc = PlatformMemory::baseMalloc();
+	#endif
+
+	#if SGL_MALLOC_TRACKER
+		// Record per-tag statistics
+		malloc = new (gMallocTrackerStorage) MallocTracker(malloc);
+	#endif
+
+		return malloc;
+	}
+}
+
 void Memory::createGMalloc()
 {
-	// Init global malloc
-	gMalloc = PlatformMemory::baseMalloc();
+	// Runs once, even if operator new gets here
+	// first during static initialization
+	static Malloc * const malloc = constructGMalloc();
+	gMalloc = malloc;
 }
\ No newline at end of file
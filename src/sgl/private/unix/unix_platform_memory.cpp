@@ -0,0 +1,120 @@
+#include "hal/platform_memory.h"
+#include "hal/platform_math.h"
+#include <sys/syscall.h>
+
+#define UNIX_HUGE_PAGE_SIZE (2 * 1024 * 1024)	// Default huge page size on x86-64, 2 MB
+#define UNIX_MPOL_PREFERRED 1					// Memory policy of mbind, see linux/mempolicy.h
+
+namespace
+{
+	/// Unmaps head and tail of a mapping, so that
+	/// the remaining range is aligned
+	void * trimMapping(void * base, sizet mapSize, sizet size, sizet alignment)
+	{
+		const uintP baseAddr = reinterpret_cast<uintP>(base);
+		const uintP outAddr = PlatformMath::alignUp(baseAddr, alignment);
+		const sizet headSize = outAddr - baseAddr;
+		const sizet tailSize = mapSize - headSize - size;
+
+		if (headSize) ::munmap(base, headSize);
+		if (tailSize) ::munmap(reinterpret_cast<void*>(outAddr + size), tailSize);
+
+		return reinterpret_cast<void*>(outAddr);
+	}
+}
+
+void * UnixPlatformMemory::map(sizet size, sizet alignment, bool bHugePages)
+{
+	const sizet pageSize = getPageSize();
+
+	size = PlatformMath::alignUp(size, pageSize);
+	alignment = PlatformMath::max(alignment, pageSize);
+
+	// Huge pages only help whole, aligned huge pages
+	bHugePages &= size >= UNIX_HUGE_PAGE_SIZE;
+	if (bHugePages) alignment = PlatformMath::max(alignment, sizet(UNIX_HUGE_PAGE_SIZE));
+
+#ifdef MAP_HUGETLB
+	// Explicit huge pages, only if the system reserved some
+	// Stop trying after the first failure
+	static volatile bool bHugeTlbAvailable = true;
+	if (bHugePages && bHugeTlbAvailable && size % UNIX_HUGE_PAGE_SIZE == 0 && alignment % UNIX_HUGE_PAGE_SIZE == 0)
+	{
+		// Huge pages are only aligned to their own
+		// size, map more and trim whole huge pages
+		const sizet mapSize = size + alignment - UNIX_HUGE_PAGE_SIZE;
+		void * base = ::mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (base != MAP_FAILED) return trimMapping(base, mapSize, size, alignment);
+
+		bHugeTlbAvailable = false;
+	}
+#endif
+
+	// Map more than necessary, then trim
+	// head and tail to align the range
+	const sizet mapSize = size + alignment - pageSize;
+	void * base = ::mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (UNLIKELY(base == MAP_FAILED)) return nullptr;
+
+	void * out = trimMapping(base, mapSize, size, alignment);
+
+#ifdef MADV_HUGEPAGE
+	// Ask for transparent huge pages
+	if (bHugePages) ::madvise(out, size, MADV_HUGEPAGE);
+#endif
+
+	return out;
+}
+
+uint32 UnixPlatformMemory::getNumNodes()
+{
+	static const uint32 numNodes = []() -> uint32 {
+
+		// Online nodes are listed as ranges, e.g. "0-1"
+		FILE * file = ::fopen("/sys/devices/system/node/online", "r");
+		if (file == nullptr) return 1;
+
+		char buffer[256];
+		const bool bRead = ::fgets(buffer, sizeof(buffer), file) != nullptr;
+		::fclose(file);
+		if (!bRead) return 1;
+
+		// Last index of the list, nodes are assumed to be contiguous
+		uint32 lastNode = 0;
+		for (const char * it = buffer; *it;)
+		{
+			if (*it >= '0' && *it <= '9')
+			{
+				lastNode = 0;
+				for (; *it >= '0' && *it <= '9'; ++it) lastNode = lastNode * 10 + (*it - '0');
+			}
+			else ++it;
+		}
+
+		return lastNode + 1;
+	}();
+
+	return numNodes;
+}
+
+uint32 UnixPlatformMemory::getCurrentNode()
+{
+#ifdef SYS_getcpu
+	unsigned int cpu, node;
+	if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return node;
+#endif
+	return 0;
+}
+
+bool UnixPlatformMemory::bindToNode(void * ptr, sizet size, uint32 node)
+{
+#ifdef SYS_mbind
+	// Preferred, not strict, binding can't fail allocations
+	if (node >= sizeof(unsigned long) * 8) return false;
+	unsigned long nodeMask = 1UL << node;
+
+	return ::syscall(SYS_mbind, ptr, size, UNIX_MPOL_PREFERRED, &nodeMask, sizeof(nodeMask) * 8, 0) == 0;
+#else
+	return false;
+#endif
+}
\ No newline at end of file
@@ -5,16 +5,21 @@
 #include "hal/platform_crt.h"
 #include "hal/platform_math.h"
 #include "hal/platform_memory.h"
-#include "hal/malloc_ansi.h"
+#include "hal/malloc_policy.h"
 #include "templates/const_ref.h"
 #include "templates/is_trivially_copyable.h"
+#include "templates/is_trivially_destructible.h"
+#include "templates/is_trivially_relocatable.h"
 
 /**
  * @class Array containers/array.h
  * A dynamic array
+ * 
+ * Memory is allocated with the allocator policy
+ * AllocT (see hal/malloc_policy.h)
  */
-template<typename T, typename AllocT = MallocAnsi>
-class GCC_ALIGN(32) Array
+template<typename T, typename AllocT = HeapAllocator>
+class GCC_ALIGN(32) Array : protected AllocT
 {
 	template<typename, typename>	friend class Array;
 									friend String;
@@ -24,11 +29,10 @@ public:
 	using Iterator		= T*;
 	using ConstIterator	= const T*;
 
-protected:
-	/// Allocator in use
-	AllocT * allocator;
-	bool bHasOwnAllocator;
+	/// Alignment of the buffer, at least alignof(T)
+	static constexpr uint32 bufferAlignment = PlatformMath::max<uint32>(alignof(T), DEFAULT_ALIGNMENT);
 
+protected:
 	/// Element buffer
 	T * buffer;
 
@@ -40,23 +44,18 @@ protected:
 
 public:
 	/// Default constructor
-	explicit FORCE_INLINE Array(uint64 _size = 2, AllocT * _allocator = reinterpret_cast<AllocT*>(gMalloc)) :
-		allocator(_allocator),
-		bHasOwnAllocator(_allocator == nullptr),
+	explicit FORCE_INLINE Array(uint64 _size = 2, const AllocT & _allocator = AllocT()) :
+		AllocT(_allocator),
 		buffer(nullptr),
 		size(_size ? _size : 2),
 		count(0U)
 	{
-		// Create a default allocator
-		if (allocator == nullptr)
-			allocator = new AllocT;
-
 		// Allocate initial buffer
-		if (size) buffer = reinterpret_cast<T*>(allocator->malloc(size * sizeof(T)));
+		if (size) buffer = reinterpret_cast<T*>(getAllocator().malloc(size * sizeof(T), bufferAlignment));
 	}
 
 	/// Copy constructor
-	FORCE_INLINE Array(const Array<T, AllocT> & other) : Array(other.size, nullptr)
+	FORCE_INLINE Array(const Array<T, AllocT> & other) : Array(other.size, other.getAllocator())
 	{
 		// Copy content
 		count = other.count;
@@ -65,7 +64,7 @@ public:
 
 	/// Copy constructor with different allocator type
 	template<typename AllocU>
-	FORCE_INLINE Array(const Array<T, AllocU> & other) : Array(other.size, nullptr)
+	FORCE_INLINE Array(const Array<T, AllocU> & other) : Array(other.size)
 	{
 		// Copy content
 		count = other.count;
@@ -74,59 +73,71 @@ public:
 
 	/// Move constructor (only if same allocator type)
 	FORCE_INLINE Array(Array<T, AllocT> && other) :
-		allocator(other.allocator),
-		bHasOwnAllocator(other.bHasOwnAllocator),
-		buffer(other.buffer),
-		size(other.size),
-		count(other.count)
+		AllocT(other.getAllocator()),
+		buffer(nullptr),
+		size(0),
+		count(0)
 	{
-		other.bHasOwnAllocator	= false;
-		other.buffer			= nullptr;
+		takeBuffer(other);
 	}
 
 	/// Copy assignment
 	FORCE_INLINE Array<T, AllocT> & operator=(const Array<T, AllocT> & other)
 	{
+		if (this == &other) return *this;
+
+		// Destroy old content
+		destroy(buffer, count);
+
 		// Realloc or create new buffer
 		if (buffer == nullptr)
 		{
 			size = other.size;
-			buffer = reinterpret_cast<T*>(allocator->malloc(size * sizeof(T)));
+			buffer = reinterpret_cast<T*>(getAllocator().malloc(size * sizeof(T), bufferAlignment));
 		}
 		else if (other.count > size)
 		{
-			allocator->free(buffer);
+			getAllocator().free(buffer);
 
 			size = other.size;
-			buffer = reinterpret_cast<T*>(allocator->malloc(size * sizeof(T)));
+			buffer = reinterpret_cast<T*>(getAllocator().malloc(size * sizeof(T), bufferAlignment));
 		}
 
 		// Copy content
 		count = other.count;
 		moveOrCopy(buffer, other.buffer, count);
+
+		return *this;
 	}
 
 	/// Copy assignment with different allocator type
 	template<typename AllocU>
-	FORCE_INLINE Array<T, AllocT> & operator=(const Array<T, AllocT> & other)
+	FORCE_INLINE Array<T, AllocT> & operator=(const Array<T, AllocU> & other)
 	{
+		if ((const void*)this == (const void*)&other) return *this;
+
+		// Destroy old content
+		destroy(buffer, count);
+
 		// Realloc or create new buffer
 		if (buffer == nullptr)
 		{
 			size = other.size;
-			buffer = reinterpret_cast<T*>(allocator->malloc(size * sizeof(T)));
+			buffer = reinterpret_cast<T*>(getAllocator().malloc(size * sizeof(T), bufferAlignment));
 		}
 		else if (other.count > size)
 		{
-			allocator->free(buffer);
+			getAllocator().free(buffer);
 
 			size = other.size;
-			buffer = reinterpret_cast<T*>(allocator->malloc(size * sizeof(T)));
+			buffer = reinterpret_cast<T*>(getAllocator().malloc(size * sizeof(T), bufferAlignment));
 		}
 
 		// Copy content
 		count = other.count;
 		moveOrCopy(buffer, other.buffer, count);
+
+		return *this;
 	}
 
 	/// Move assignment
@@ -134,32 +145,98 @@ public:
 	{
 		// Free existing buffer
 		if (buffer)
-			allocator->free(buffer);
-
-		// Free own allocator
-		if (bHasOwnAllocator)
-			delete allocator;
+		{
+			destroy(buffer, count);
+			getAllocator().free(buffer);
+		}
 
-		allocator			= other.allocator;
-		bHasOwnAllocator	= other.bHasOwnAllocator;
-		buffer				= other.buffer;
-		size				= other.size;
-		count				= other.count;
+		getAllocator() = other.getAllocator();
+		takeBuffer(other);
 
-		other.bHasOwnAllocator	= false;
-		other.buffer			= nullptr; 
+		return *this;
 	}
 
 	/// Destructor
 	FORCE_INLINE ~Array()
 	{
-		//if (buffer)
-			//allocator->free(buffer);
-		
-		if (bHasOwnAllocator)
-			delete allocator;
+		if (buffer)
+		{
+			destroy(buffer, count);
+			getAllocator().free(buffer);
+		}
+	}
+
+	/// Returns allocator policy
+	/// @{
+	FORCE_INLINE AllocT &		getAllocator()			{ return *this; }
+	FORCE_INLINE const AllocT &	getAllocator() const	{ return *this; }
+	/// @}
+
+protected:
+	/// Takes buffer of another array, items stored
+	/// inside the other allocator are relocated
+	/// instead. Other array is left empty
+	FORCE_INLINE void takeBuffer(Array<T, AllocT> & other)
+	{
+		size	= other.size;
+		count	= other.count;
+
+		if (UNLIKELY(other.getAllocator().isInline(other.buffer)))
+		{
+			buffer = reinterpret_cast<T*>(getAllocator().malloc(size * sizeof(T), bufferAlignment));
+			relocate(buffer, other.buffer, count);
+
+			other.getAllocator().free(other.buffer);
+		}
+		else
+			buffer = other.buffer;
+
+		other.buffer	= nullptr;
+		other.size		= 0;
+		other.count		= 0;
+	}
+
+	/// Destroys n elements
+	static FORCE_INLINE void destroy(T * items, uint64 n)
+	{
+		if (!IsTriviallyDestructible<T>::value)
+			for (uint64 i = 0; i < n; ++i) items[i].~T();
 	}
 
+	/**
+	 * Moves n elements to a possibly overlapping
+	 * destination. Source slots outside of the
+	 * destination are left unconstructed
+	 * 
+	 * @param [in] dest destination of elements
+	 * @param [in] src current position of elements
+	 * @param [in] n number of elements
+	 */
+	static FORCE_INLINE void relocate(T * dest, T * src, uint64 n)
+	{
+		if (IsTriviallyRelocatable<T>::value)
+			PlatformMemory::memmove(dest, src, n * sizeof(T));
+		else if (dest < src)
+		{
+			for (uint64 i = 0; i < n; ++i)
+			{
+				new (dest + i) T(std::move(src[i]));
+				src[i].~T();
+			}
+		}
+		else if (dest > src)
+		{
+			// Back to front, don't overwrite source
+			for (uint64 i = n; i > 0; --i)
+			{
+				new (dest + i - 1) T(std::move(src[i - 1]));
+				src[i - 1].~T();
+			}
+		}
+	}
+
+public:
+
 	/// Returns raw content
 	/// @{
 	FORCE_INLINE T *		operator*()			{ return buffer; }
@@ -196,16 +273,44 @@ public:
 	/// Returns true if array is valid
 	FORCE_INLINE bool isValid() const { return buffer && size; }
 
-	/// Force resize array
+	/**
+	 * Force resize array, elements past the new
+	 * size are destroyed
+	 * 
+	 * @param [in] _size new size of the array
+	 * @return true if buffer was resized
+	 */
 	FORCE_INLINE bool resize(uint64 _size)
 	{
 		if (_size != size)
 		{
-			// Realloc buffer
-			buffer = reinterpret_cast<T*>(allocator->realloc(buffer, _size * sizeof(T)));
-
-			size	= _size;
-			count	= PlatformMath::min(count, size);
+			if (_size < count)
+			{
+				destroy(buffer + _size, count - _size);
+				count = _size;
+			}
+
+			if (_size == 0)
+			{
+				getAllocator().free(buffer);
+				buffer = nullptr;
+			}
+			else if (IsTriviallyRelocatable<T>::value || buffer == nullptr)
+			{
+				// Realloc buffer
+				buffer = reinterpret_cast<T*>(getAllocator().realloc(buffer, _size * sizeof(T), bufferAlignment));
+			}
+			else
+			{
+				// Move elements to new buffer
+				T * _buffer = reinterpret_cast<T*>(getAllocator().malloc(_size * sizeof(T), bufferAlignment));
+				relocate(_buffer, buffer, count);
+
+				getAllocator().free(buffer);
+				buffer = _buffer;
+			}
+
+			size = _size;
 
 			// Buffer was resized
 			return true;
@@ -214,16 +319,47 @@ public:
 		return false;
 	}
 
+	/**
+	 * Makes room for at least n elements. Slack
+	 * space left by the allocator is claimed
+	 * as well
+	 * 
+	 * @param [in] n required number of elements
+	 * @return true if buffer was resized
+	 */
+	FORCE_INLINE bool reserve(uint64 n)
+	{
+		if (n > size)
+		{
+			resize(n);
+
+			// Claim slack space
+			sizet bytes;
+			if (getAllocator().getAllocSize(buffer, bytes))
+				size = PlatformMath::max<uint64>(size, bytes / sizeof(T));
+
+			return true;
+		}
+
+		return false;
+	}
+
+	/// Shrinks buffer to current number of elements
+	FORCE_INLINE bool shrinkToFit()
+	{
+		return resize(count);
+	}
+
 protected:
 	/// Resize only if new count is bigger than current size
 	FORCE_INLINE bool resizeIfNecessary(uint64 _count)
 	{
 		if (_count > size)
 		{
-			uint64 _size = size * 2;
+			uint64 _size = size ? size * 2 : 2;
 			while (_count > _size) _size *= 2;
 
-			return resize(_size);
+			return reserve(_size);
 		}
 
 		return false;
@@ -280,7 +416,7 @@ public:
 
 		// Move content up
 		if (LIKELY(i < count))
-			PlatformMemory::memmove(buffer + i + 1, buffer + i, (count - i) * sizeof(T));
+			relocate(buffer + i + 1, buffer + i, count - i);
 		
 		// Construct object
 		moveOrCopy(buffer[i], item);
@@ -300,7 +436,7 @@ public:
 
 		// Move content up
 		if (i < count)
-			PlatformMemory::memmove(buffer + i + n, buffer + i, (count - i) * sizeof(T));
+			relocate(buffer + i + n, buffer + i, count - i);
 
 		// Construct objects
 		moveOrCopy(buffer + i, items, n);
@@ -342,6 +478,41 @@ public:
 	FORCE_INLINE void push(const T * items, uint64 n) { add(items, n); }
 	/// @}
 
+	/**
+	 * Constructs a new item in place at the end
+	 * of the array
+	 * 
+	 * @param [in] args arguments of T constructor
+	 * @return ref to new item
+	 */
+	template<typename ... ArgsT>
+	FORCE_INLINE T & emplace(ArgsT && ... args)
+	{
+		resizeIfNecessary(count + 1);
+
+		return *new (buffer + count++) T(std::forward<ArgsT>(args)...);
+	}
+
+	/**
+	 * Constructs a new item in place at position
+	 * 
+	 * @param [in] i target position
+	 * @param [in] args arguments of T constructor
+	 * @return ref to new item
+	 */
+	template<typename ... ArgsT>
+	FORCE_INLINE T & emplaceAt(uint64 i, ArgsT && ... args)
+	{
+		resizeIfNecessary(count + 1);
+
+		// Move content up
+		if (LIKELY(i < count))
+			relocate(buffer + i + 1, buffer + i, count - i);
+
+		++count;
+		return *new (buffer + i) T(std::forward<ArgsT>(args)...);
+	}
+
 	/**
 	 * Remove items at position
 	 * 
@@ -350,16 +521,28 @@ public:
 	 */
 	FORCE_INLINE void removeAt(uint64 i, uint64 n = 1)
 	{
-		// Just move back memory
-		if (i < count)
-			PlatformMemory::memmove(buffer + i, buffer + i + n, (count - i) * sizeof(T));
+		destroy(buffer + i, n);
+
+		// Move content back
+		if (i + n < count)
+			relocate(buffer + i, buffer + i + n, count - i - n);
 		
 		count -= n;
 	}
 
 	/// Remove item at the end of the array
-	FORCE_INLINE void pop(uint64 i, uint64 n)
-	{		
-		--count;
+	FORCE_INLINE void pop()
+	{
+		destroy(buffer + --count, 1);
 	}
-};
\ No newline at end of file
+};
+
+/// Arrays are relocatable unless their buffer
+/// is stored inside the allocator
+template<typename T, typename AllocT>
+struct IsTriviallyRelocatable<Array<T, AllocT>> { enum {value = IsTriviallyRelocatable<AllocT>::value}; };
+
+/// An array that stores up to N elements inline,
+/// and allocates with AllocT when it grows past them
+template<typename T, uint64 N, typename AllocT = HeapAllocator>
+using InlineArray = Array<T, InlineAllocator<N * sizeof(T), PlatformMath::max<uint32>(alignof(T), DEFAULT_ALIGNMENT), AllocT>>;
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 #include "core_types.h"
 #include "hal/platform_memory.h"
-#include "hal/malloc_ansi.h"
+#include "hal/malloc_policy.h"
 #include "templates/const_ref.h"
 #include "templates/functional.h"
 
@@ -281,11 +281,12 @@ using BinaryNodeRef = BinaryNode<T, CompareT>*;
 /**
  * @class Tree containers/tree.h
  * 
- * A templated red-black tree.
+ * A templated red-black tree. Nodes are
+ * allocated with the allocator policy AllocT
  * @see BinaryNode
  */
-template<typename T, typename CompareT = Compare, typename AllocT = MallocAnsi>
-class GCC_ALIGN(32) BinaryTree
+template<typename T, typename CompareT = Compare, typename AllocT = HeapAllocator>
+class GCC_ALIGN(32) BinaryTree : protected AllocT
 {
 	template<typename, typename, typename>				friend class BinaryTree;
 	template<typename, typename, typename, typename>	friend class Map;
@@ -360,10 +361,6 @@ public:
 	using ConstIterator	= NodeIterator<const T>;
 
 protected:
-	/// Allocator used to allocate new nodes
-	AllocT * allocator;
-	bool bHasOwnAllocator;
-
 	/// Root node
 	NodeRef root;
 
@@ -372,24 +369,42 @@ protected:
 
 public:
 	/// Default constructor
-	FORCE_INLINE BinaryTree(AllocT * _allocator = reinterpret_cast<AllocT*>(gMalloc)) :
-		allocator(_allocator),
-		bHasOwnAllocator(_allocator == nullptr),
+	FORCE_INLINE BinaryTree(const AllocT & _allocator = AllocT()) :
+		AllocT(_allocator),
 		root(nullptr),
-		numNodes(0)
-	{
-		// Create own allocator
-		if (bHasOwnAllocator)
-			allocator = new AllocT;
-		/* else
-			printf("%p\n", allocator); */
-	}
+		numNodes(0) {}
 
 protected:
 	/// Create a new node using the class allocator
 	FORCE_INLINE NodeRef createNode(typename ConstRef<T>::Type data)
 	{
-		return new (reinterpret_cast<NodeRef>(allocator->malloc(sizeof(Node)))) Node(data);
+		return new (reinterpret_cast<NodeRef>(getAllocator().malloc(sizeof(Node), alignof(Node)))) Node(data);
+	}
+
+	/// Create a new node using a batch of blocks
+	FORCE_INLINE NodeRef createNode(typename ConstRef<T>::Type data, MallocBatch<AllocT> & batch)
+	{
+		return new (reinterpret_cast<NodeRef>(batch.malloc())) Node(data);
+	}
+
+	/// Recursively copy structure of another tree
+	/// in new nodes, allocated in batches
+	template<typename U>
+	void copyStructure(NodeRef replica, BinaryNodeRef<U> original, MallocBatch<AllocT> & batch)
+	{
+		replica->color = typename Node::NodeColor(original->color);
+
+		if (original->left)
+		{
+			replica->setLeftChild(createNode(original->left->data, batch));
+			copyStructure(replica->left, original->left, batch);
+		}
+
+		if (original->right)
+		{
+			replica->setRightChild(createNode(original->right->data, batch));
+			copyStructure(replica->right, original->right, batch);
+		}
 	}
 
 	/// Recursively replicate structure of another tree
@@ -429,39 +444,43 @@ protected:
 
 public:
 	/// Copy constructor
-	FORCE_INLINE BinaryTree(const BinaryTree<T, AllocT> & other) : BinaryTree(nullptr)
+	FORCE_INLINE BinaryTree(const BinaryTree<T, CompareT, AllocT> & other) : BinaryTree(other.getAllocator())
 	{
 		if (other.root)
+		{
 			// Copy the tree structure as-is
-			replicateStructure(root = createNode(other.root->data), other.root);
+			MallocBatch<AllocT> batch(&getAllocator(), sizeof(Node), other.numNodes, alignof(Node));
+			copyStructure(root = createNode(other.root->data, batch), other.root, batch);
+		}
 		
 		numNodes = other.numNodes;
 	}
 
 	/// Copy constructor (different allocator)
 	template<typename AllocU>
-	FORCE_INLINE BinaryTree(const BinaryTree<T, AllocU> & other) : BinaryTree(nullptr)
+	FORCE_INLINE BinaryTree(const BinaryTree<T, CompareT, AllocU> & other) : BinaryTree()
 	{
 		if (other.root)
+		{
 			// Copy the tree structure as-is
-			replicateStructure(root = createNode(other.root->data), other.root);
+			MallocBatch<AllocT> batch(&getAllocator(), sizeof(Node), other.numNodes, alignof(Node));
+			copyStructure(root = createNode(other.root->data, batch), other.root, batch);
+		}
 		
 		numNodes = other.numNodes;
 	}
 
 	/// Move constructor
-	FORCE_INLINE BinaryTree(BinaryTree<T, AllocT> && other) :
-		allocator(other.allocator),
-		bHasOwnAllocator(other.bHasOwnAllocator),
+	FORCE_INLINE BinaryTree(BinaryTree<T, CompareT, AllocT> && other) :
+		AllocT(other.getAllocator()),
 		root(other.root),
 		numNodes(other.numNodes)
 	{
-		other.bHasOwnAllocator = false;
 		other.root = nullptr;
 	}
 
 	/// Copy assignment
-	FORCE_INLINE BinaryTree<T, AllocT> & operator=(const BinaryTree<T, AllocT> & other)
+	FORCE_INLINE BinaryTree<T, CompareT, AllocT> & operator=(const BinaryTree<T, CompareT, AllocT> & other)
 	{
 		// Copy the tree structure as-is
 		if (other.root)
@@ -476,11 +495,12 @@ public:
 		}
 		
 		numNodes = other.numNodes;
+		return *this;
 	}
 
 	/// Copy assignment (different allocator)
 	template<typename AllocU>
-	FORCE_INLINE BinaryTree<T, AllocT> & operator=(const BinaryTree<T, AllocU> & other)
+	FORCE_INLINE BinaryTree<T, CompareT, AllocT> & operator=(const BinaryTree<T, CompareT, AllocU> & other)
 	{
 		// Copy the tree structure as-is
 		if (other.root)
@@ -495,18 +515,21 @@ public:
 		}
 		
 		numNodes = other.numNodes;
+		return *this;
 	}
 
 	/// Move assignment
-	FORCE_INLINE BinaryTree<T, AllocT> & operator=(BinaryTree<T, AllocT> && other)
+	FORCE_INLINE BinaryTree<T, CompareT, AllocT> & operator=(BinaryTree<T, CompareT, AllocT> && other)
 	{
-		allocator			= other.allocator;
-		bHasOwnAllocator	= other.bHasOwnAllocator;
-		root				= other.root;
-		numNodes			= other.numNodes;
+		// Empty self first
+		empty(root);
+
+		getAllocator()	= other.getAllocator();
+		root			= other.root;
+		numNodes		= other.numNodes;
 
-		other.bHasOwnAllocator	= false;
-		other.root				= nullptr;
+		other.root = nullptr;
+		return *this;
 	}
 
 	/// Destructor
@@ -514,12 +537,14 @@ public:
 	{
 		// Empty tree
 		empty(root);
-
-		// Delete own allocator
-		if (bHasOwnAllocator)
-			delete allocator;
 	}
 
+	/// Returns allocator policy
+	/// @{
+	FORCE_INLINE AllocT &		getAllocator()			{ return *this; }
+	FORCE_INLINE const AllocT &	getAllocator() const	{ return *this; }
+	/// @}
+
 public:
 	/// Get number of nodes
 	FORCE_INLINE uint64 getSize() const { return numNodes; }
@@ -582,7 +607,7 @@ public:
 				root = root->getRoot();
 			}
 			else
-				allocator->free(node);
+				getAllocator().free(node);
 
 			return actualNode->data;
 		}
@@ -610,7 +635,7 @@ protected:
 				right	= node->right;
 			
 			// Dealloc node
-			allocator->free(node);
+			getAllocator().free(node);
 
 			// Depth first
 			empty(left), empty(right);
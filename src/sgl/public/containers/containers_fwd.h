@@ -4,7 +4,9 @@
 
 template<typename, typename>						class Array;
 template<typename, typename, typename>				class BinaryTree;
-template<typename, typename, typename>				class HashMap;
+template<typename, typename, typename, typename>	class HashMap;
+template<typename, typename, typename>				class HashSet;
+template<typename, typename, typename, typename>	class HashTable;
 template<typename, typename>						class LinkedList;
 template<typename, typename, typename, typename>	class Map;
 template<typename, typename>						class Pair;
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "core_types.h"
+#include "pair.h"
+#include "hash_table.h"
+#include "hal/malloc_policy.h"
+
+/**
+ * @class HashMap containers/hash_map.h
+ * 
+ * A map built on top of an open addressing hash
+ * table (see @ref HashTable)
+ * 
+ * Keys are not sorted. Insertion, deletion and
+ * search are O(1) on average, and a search
+ * usually touches a single group of control bytes
+ * and a single slot. Pairs are stored inline in
+ * the slots and move when the table grows, thus
+ * refs to pairs are invalidated by insertions.
+ * 
+ * Searches accept any key type that can be
+ * compared with KeyT and that HashT hashes to the
+ * same value, e.g. a HashMap<String, ValT> can be
+ * searched with a const ansichar*
+ */
+template<typename KeyT, typename ValT, typename HashT = Hash, typename AllocT = HeapAllocator>
+class HashMap
+{
+public:
+	/// Pair type
+	using PairT = Pair<KeyT, ValT>;
+
+	/// Table type
+	using TableT = HashTable<PairT, HashPairKey, HashT, AllocT>;
+
+	/// Iterators
+	using Iterator		= typename TableT::Iterator;
+	using ConstIterator	= typename TableT::ConstIterator;
+
+protected:
+	/// Hash table used for pair storage
+	TableT table;
+
+public:
+	/// Default constructor
+	FORCE_INLINE HashMap(const AllocT & allocator = AllocT()) :
+		table(allocator) {}
+
+	/// Returns allocator policy
+	/// @{
+	FORCE_INLINE AllocT &		getAllocator()			{ return table.getAllocator(); }
+	FORCE_INLINE const AllocT &	getAllocator() const	{ return table.getAllocator(); }
+	/// @}
+
+	/// Returns number of pairs
+	FORCE_INLINE uint64 getCount() const { return table.getCount(); }
+
+	/// Returns true if map is empty
+	FORCE_INLINE bool isEmpty() const { return table.isEmpty(); }
+
+	/**
+	 * Find value using key
+	 * 
+	 * @param [in] key search key
+	 * @return map iterator
+	 * @{
+	 */
+	template<typename KeyU>
+	FORCE_INLINE Iterator find(const KeyU & key)
+	{
+		return table.find(key);
+	}
+	template<typename KeyU>
+	FORCE_INLINE ConstIterator find(const KeyU & key) const
+	{
+		return table.find(key);
+	}
+	/// @}
+
+	/// Returns true if key exists
+	template<typename KeyU>
+	FORCE_INLINE bool contains(const KeyU & key) const
+	{
+		return table.contains(key);
+	}
+
+	/// STL compliant iterators
+	/// @{
+	FORCE_INLINE Iterator		begin()			{ return table.begin(); }
+	FORCE_INLINE ConstIterator	begin() const	{ return table.begin(); }
+
+	FORCE_INLINE Iterator		end()		{ return table.end(); }
+	FORCE_INLINE ConstIterator	end() const	{ return table.end(); }
+	/// @}
+
+	/**
+	 * Returns ref to value associated with key
+	 * 
+	 * If key doesn't exist, create a new one
+	 * 
+	 * @param [in] key search key
+	 * @return ref to associated value
+	 */
+	FORCE_INLINE ValT & operator[](typename ConstRef<KeyT>::Type key)
+	{
+		return table.findOrEmplace(key, key).second;
+	}
+
+	/**
+	 * Insert a new unique pair
+	 * 
+	 * @param [in] pair <key, value> pair to insert
+	 * @param [in] key key value
+	 * @param [in] val pair value
+	 * @return inserted pair or pair that prevented insertion
+	 * @{
+	 */
+	FORCE_INLINE PairT & insert(const PairT & pair)
+	{
+		return table.findOrEmplace(pair.first, pair);
+	}
+	FORCE_INLINE PairT & insert(typename ConstRef<KeyT>::Type key, typename ConstRef<ValT>::Type val)
+	{
+		return table.findOrEmplace(key, key, val);
+	}
+	/// @}
+
+	/**
+	 * Remove pair with key
+	 * 
+	 * @param [in] key search key
+	 * @return true if pair was found
+	 */
+	template<typename KeyU>
+	FORCE_INLINE bool remove(const KeyU & key)
+	{
+		return table.remove(key);
+	}
+
+	/// Makes room for n pairs
+	FORCE_INLINE void reserve(uint64 n) { table.reserve(n); }
+
+	/// Removes all pairs
+	FORCE_INLINE void empty() { table.empty(); }
+};
\ No newline at end of file
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "core_types.h"
+#include "array.h"
+#include "hash_table.h"
+#include "hal/malloc_policy.h"
+
+/**
+ * @class HashSet containers/hash_set.h
+ * 
+ * A set of unique items built on top of an open
+ * addressing hash table (see @ref HashTable)
+ * 
+ * Items are not sorted, iteration follows slot
+ * order. Items are stored inline in the slots and
+ * move when the set grows, thus refs to items are
+ * invalidated by insertions. Items can't be
+ * modified in place, since that would change
+ * their hash.
+ * 
+ * Union and intersection scan the control bytes
+ * of a set one group at a time, rather than
+ * iterating slot by slot
+ */
+template<typename T, typename HashT = Hash, typename AllocT = HeapAllocator>
+class HashSet
+{
+	template<typename, typename, typename> friend class HashSet;
+
+public:
+	/// Table type
+	using TableT = HashTable<T, HashItemKey, HashT, AllocT>;
+
+	/// Iterators, items are read-only
+	using Iterator		= typename TableT::ConstIterator;
+	using ConstIterator	= typename TableT::ConstIterator;
+
+protected:
+	/// Hash table used for item storage
+	TableT table;
+
+public:
+	/// Default constructor
+	FORCE_INLINE HashSet(const AllocT & allocator = AllocT()) :
+		table(allocator) {}
+
+	/// Buffer constructor
+	FORCE_INLINE HashSet(const T * items, uint64 n, const AllocT & allocator = AllocT()) :
+		table(allocator)
+	{
+		insert(items, n);
+	}
+
+	/// Returns allocator policy
+	/// @{
+	FORCE_INLINE AllocT &		getAllocator()			{ return table.getAllocator(); }
+	FORCE_INLINE const AllocT &	getAllocator() const	{ return table.getAllocator(); }
+	/// @}
+
+	/// Returns number of items
+	FORCE_INLINE uint64 getCount() const { return table.getCount(); }
+
+	/// Returns true if set is empty
+	FORCE_INLINE bool isEmpty() const { return table.isEmpty(); }
+
+	/**
+	 * Find item
+	 * 
+	 * @param [in] item search item, or any type that
+	 * 	can be compared with T and hashes the same
+	 * @return set iterator
+	 */
+	template<typename U>
+	FORCE_INLINE ConstIterator find(const U & item) const
+	{
+		return table.find(item);
+	}
+
+	/// Returns true if item exists
+	template<typename U>
+	FORCE_INLINE bool contains(const U & item) const
+	{
+		return table.contains(item);
+	}
+
+	/// STL compliant iterators
+	/// @{
+	FORCE_INLINE ConstIterator begin() const	{ return static_cast<const TableT&>(table).begin(); }
+	FORCE_INLINE ConstIterator end() const		{ return static_cast<const TableT&>(table).end(); }
+	/// @}
+
+	/**
+	 * Insert item if not already in set
+	 * 
+	 * @param [in] item item to insert
+	 * @return inserted item or item that prevented insertion
+	 * @{
+	 */
+	FORCE_INLINE const T & insert(const T & item)
+	{
+		return table.findOrEmplace(item, item);
+	}
+	FORCE_INLINE const T & insert(T && item)
+	{
+		return table.findOrEmplace(item, std::move(item));
+	}
+	/// @}
+
+	/**
+	 * Insert many items, makes room for all of
+	 * them beforehand
+	 * 
+	 * @param [in] items items to insert
+	 * @param [in] n number of items
+	 * @{
+	 */
+	FORCE_INLINE void insert(const T * items, uint64 n)
+	{
+		table.reserve(table.getCount() + n);
+		for (uint64 i = 0; i < n; ++i) table.findOrEmplace(items[i], items[i]);
+	}
+	template<typename AllocU>
+	FORCE_INLINE void insert(const Array<T, AllocU> & items)
+	{
+		insert(*items, items.getCount());
+	}
+	/// @}
+
+	/**
+	 * Remove item
+	 * 
+	 * @param [in] item search item
+	 * @return true if item was found
+	 */
+	template<typename U>
+	FORCE_INLINE bool remove(const U & item)
+	{
+		return table.remove(item);
+	}
+
+	/// Makes room for n items
+	FORCE_INLINE void reserve(uint64 n) { table.reserve(n); }
+
+	/// Removes all items
+	FORCE_INLINE void empty() { table.empty(); }
+
+	/**
+	 * Adds all items of another set
+	 * 
+	 * @param [in] other set operand
+	 * @return self
+	 */
+	template<typename AllocU>
+	HashSet<T, HashT, AllocT> & unite(const HashSet<T, HashT, AllocU> & other)
+	{
+		table.reserve(table.getCount() + other.getCount());
+		other.table.forEach([this](const T & item) {
+
+			table.findOrEmplace(item, item);
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Removes all items not in another set
+	 * 
+	 * @param [in] other set operand
+	 * @return self
+	 */
+	template<typename AllocU>
+	HashSet<T, HashT, AllocT> & intersect(const HashSet<T, HashT, AllocU> & other)
+	{
+		table.removeIf([&other](const T & item) {
+
+			return !other.contains(item);
+		});
+
+		return *this;
+	}
+
+	/**
+	 * Set operators
+	 * 
+	 * @param [in] other set operand
+	 * @return new set, or self
+	 * @{
+	 */
+	FORCE_INLINE HashSet<T, HashT, AllocT> & operator|=(const HashSet<T, HashT, AllocT> & other) { return unite(other); }
+	FORCE_INLINE HashSet<T, HashT, AllocT> & operator&=(const HashSet<T, HashT, AllocT> & other) { return intersect(other); }
+
+	HashSet<T, HashT, AllocT> operator|(const HashSet<T, HashT, AllocT> & other) const
+	{
+		// Copy larger set, control bytes are copied as-is
+		const bool bSwap = other.getCount() > getCount();
+		HashSet<T, HashT, AllocT> out(bSwap ? other : *this);
+		out.unite(bSwap ? *this : other);
+
+		return out;
+	}
+
+	HashSet<T, HashT, AllocT> operator&(const HashSet<T, HashT, AllocT> & other) const
+	{
+		// Scan smaller set, probe larger one
+		const bool bSwap = other.getCount() < getCount();
+		const HashSet<T, HashT, AllocT> & smaller = bSwap ? other : *this;
+		const HashSet<T, HashT, AllocT> & larger = bSwap ? *this : other;
+
+		HashSet<T, HashT, AllocT> out(getAllocator());
+		out.reserve(smaller.getCount());
+		smaller.table.forEach([&out, &larger](const T & item) {
+
+			if (larger.contains(item)) out.table.findOrEmplace(item, item);
+		});
+
+		return out;
+	}
+	/// @}
+};
\ No newline at end of file
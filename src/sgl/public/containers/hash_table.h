@@ -0,0 +1,759 @@
+#pragma once
+
+#include "core_types.h"
+#include "containers_fwd.h"
+#include "hal/platform_math.h"
+#include "hal/platform_memory.h"
+#include "hal/malloc_policy.h"
+#include "templates/hash.h"
+#include "templates/is_trivially_copyable.h"
+#include "templates/is_trivially_destructible.h"
+#include "templates/is_trivially_relocatable.h"
+
+/**
+ * @struct HashGroup containers/hash_table.h
+ * 
+ * A group of consecutive control bytes of a hash
+ * table, matched all at once: 32 bytes with AVX2,
+ * 16 bytes with SSE2, 8 bytes in a 64 bit integer
+ * otherwise.
+ * 
+ * A control byte is negative if the slot is free,
+ * otherwise it stores the 7 low bits of the hash
+ * of the item. Matches are returned as bitmasks,
+ * iterated with @ref getIndex() and @ref next()
+ */
+struct HashGroup
+{
+	/// Control values of free slots
+	enum : int8
+	{
+		EMPTY		= -128,
+		DELETED		= -2,
+		SENTINEL	= -1
+	};
+
+#if PLATFORM_ENABLE_SIMD && defined(__AVX2__)
+	/// Bitmask type
+	using Mask = uint32;
+
+	/// Number of slots in a group
+	static constexpr uint32 numSlots = 32;
+
+	/// Control bytes
+	__m256i ctrl;
+
+	/// Loads control bytes, unaligned
+	FORCE_INLINE explicit HashGroup(const int8 * control) : ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(control))) {}
+
+	/// Returns slots with given hash bits
+	FORCE_INLINE Mask match(int8 h2) const { return _mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(h2))); }
+
+	/// Returns empty slots
+	FORCE_INLINE Mask matchEmpty() const { return match(EMPTY); }
+
+	/// Returns free slots
+	FORCE_INLINE Mask matchFree() const { return _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(SENTINEL), ctrl)); }
+
+	/// Returns full slots
+	FORCE_INLINE Mask matchFull() const { return ~_mm256_movemask_epi8(ctrl); }
+
+	/// Returns number of free slots at the beginning of the group
+	FORCE_INLINE uint32 countLeadingFree() const { return PlatformMath::getTrailingZeros(~uint64(matchFree())); }
+
+	/// Returns index of first slot in mask
+	static FORCE_INLINE uint32 getIndex(Mask mask) { return PlatformMath::getTrailingZeros(mask); }
+
+	/// Returns number of slots after the last slot in mask
+	static FORCE_INLINE uint32 getNumAfterLast(Mask mask) { return PlatformMath::getLeadingZeros(uint64(mask)) - (64 - numSlots); }
+#elif PLATFORM_ENABLE_SIMD
+	/// Bitmask type
+	using Mask = uint32;
+
+	/// Number of slots in a group
+	static constexpr uint32 numSlots = 16;
+
+	/// Control bytes
+	__m128i ctrl;
+
+	/// Loads control bytes, unaligned
+	FORCE_INLINE explicit HashGroup(const int8 * control) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(control))) {}
+
+	/// Returns slots with given hash bits
+	FORCE_INLINE Mask match(int8 h2) const { return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))); }
+
+	/// Returns empty slots
+	FORCE_INLINE Mask matchEmpty() const { return match(EMPTY); }
+
+	/// Returns free slots
+	FORCE_INLINE Mask matchFree() const { return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(SENTINEL), ctrl)); }
+
+	/// Returns full slots
+	FORCE_INLINE Mask matchFull() const { return ~_mm_movemask_epi8(ctrl) & 0xffff; }
+
+	/// Returns number of free slots at the beginning of the group
+	FORCE_INLINE uint32 countLeadingFree() const { return PlatformMath::getTrailingZeros(~uint64(matchFree())); }
+
+	/// Returns index of first slot in mask
+	static FORCE_INLINE uint32 getIndex(Mask mask) { return PlatformMath::getTrailingZeros(mask); }
+
+	/// Returns number of slots after the last slot in mask
+	static FORCE_INLINE uint32 getNumAfterLast(Mask mask) { return PlatformMath::getLeadingZeros(uint64(mask)) - (64 - numSlots); }
+#else
+	/// Bitmask type, one bit per byte
+	using Mask = uint64;
+
+	/// Number of slots in a group
+	static constexpr uint32 numSlots = 8;
+
+	/// Byte masks
+	/// @{
+	static constexpr uint64 lsbs = 0x0101010101010101ULL;
+	static constexpr uint64 msbs = 0x8080808080808080ULL;
+	/// @}
+
+	/// Control bytes, little endian
+	uint64 ctrl;
+
+	/// Loads control bytes, unaligned
+	FORCE_INLINE explicit HashGroup(const int8 * control) { PlatformMemory::memcpy(&ctrl, control, sizeof(ctrl)); }
+
+	/// Returns slots with given hash bits, may
+	/// return false positives after a match
+	FORCE_INLINE Mask match(int8 h2) const
+	{
+		const uint64 x = ctrl ^ (lsbs * uint8(h2));
+		return (x - lsbs) & ~x & msbs;
+	}
+
+	/// Returns empty slots
+	FORCE_INLINE Mask matchEmpty() const { return ctrl & ~(ctrl << 6) & msbs; }
+
+	/// Returns free slots
+	FORCE_INLINE Mask matchFree() const { return ctrl & ~(ctrl << 7) & msbs; }
+
+	/// Returns full slots
+	FORCE_INLINE Mask matchFull() const { return ~ctrl & msbs; }
+
+	/// Returns number of free slots at the beginning of the group
+	FORCE_INLINE uint32 countLeadingFree() const
+	{
+		const Mask mask = ~matchFree() & msbs;
+		return mask ? getIndex(mask) : numSlots;
+	}
+
+	/// Returns index of first slot in mask
+	static FORCE_INLINE uint32 getIndex(Mask mask) { return PlatformMath::getTrailingZeros(mask) >> 3; }
+
+	/// Returns number of slots after the last slot in mask
+	static FORCE_INLINE uint32 getNumAfterLast(Mask mask) { return PlatformMath::getLeadingZeros(mask) >> 3; }
+#endif
+
+	/// Removes first slot from mask
+	static FORCE_INLINE Mask next(Mask mask) { return mask & (mask - 1); }
+
+	/// Returns control bytes shared by all empty
+	/// tables, a sentinel followed by empty slots
+	static FORCE_INLINE int8 * getEmptyControl()
+	{
+		struct EmptyControl
+		{
+			int8 bytes[numSlots];
+
+			EmptyControl()
+			{
+				PlatformMemory::memset(bytes, EMPTY, numSlots);
+				bytes[0] = SENTINEL;
+			}
+		};
+
+		static EmptyControl emptyControl;
+		return emptyControl.bytes;
+	}
+};
+
+/// Returns the item itself as key
+struct HashItemKey
+{
+	template<typename T>
+	FORCE_INLINE const T & operator()(const T & item) const { return item; }
+};
+
+/// Returns the first element of a pair as key
+struct HashPairKey
+{
+	template<typename PairT>
+	FORCE_INLINE const auto & operator()(const PairT & pair) const { return pair.first; }
+};
+
+/**
+ * @class HashTable containers/hash_table.h
+ * 
+ * An open addressing hash table, the common core
+ * of @ref HashMap and @ref HashSet. KeyOfT returns
+ * the key of an item, HashT hashes keys.
+ * 
+ * Every slot has a control byte, stored in a
+ * separate dense array. The high bits of the hash
+ * select the first group of slots to probe, the
+ * low 7 bits are stored in the control byte, so
+ * that a whole group is matched with a single SIMD
+ * compare and keys are compared only on a match.
+ * Groups are probed quadratically until a group
+ * with an empty slot is found.
+ * 
+ * The number of slots is a power of two minus one.
+ * The first numSlots - 1 control bytes are cloned
+ * after the last one and a sentinel, so that groups
+ * can be loaded at any slot without wrapping. The
+ * table grows when 7/8 of the slots are used,
+ * removed items leave a tombstone. Control bytes
+ * and slots share a single allocation, an empty
+ * table doesn't allocate
+ */
+template<typename ItemT, typename KeyOfT, typename HashT = Hash, typename AllocT = HeapAllocator>
+class GCC_ALIGN(32) HashTable : protected AllocT
+{
+	template<typename, typename, typename, typename> friend class HashTable;
+
+public:
+	/// Group type
+	using Group = HashGroup;
+
+	/// Minimum number of slots
+	static constexpr uint64 minCapacity = Group::numSlots - 1;
+
+	/// Alignment of the allocation
+	static constexpr uint32 bufferAlignment = PlatformMath::max<uint32>(alignof(ItemT), DEFAULT_ALIGNMENT);
+
+	/**
+	 * @class SlotIterator containers/hash_table.h
+	 * 
+	 * Iterates over full slots, in slot order
+	 */
+	template<typename U>
+	class SlotIterator
+	{
+		template<typename, typename, typename, typename> friend class HashTable;
+
+	protected:
+		/// Current control byte
+		const int8 * ctrl;
+
+		/// Current slot
+		U * slot;
+
+		/// Iterator constructor
+		FORCE_INLINE SlotIterator(const int8 * _ctrl, U * _slot) :
+			ctrl(_ctrl),
+			slot(_slot) {}
+
+		/// Skips free slots, stops at sentinel
+		FORCE_INLINE void skipFree()
+		{
+			while (*ctrl < Group::SENTINEL)
+			{
+				const uint32 n = Group(ctrl).countLeadingFree();
+				ctrl += n, slot += n;
+			}
+		}
+
+	public:
+		/// Advances iterator
+		FORCE_INLINE SlotIterator<U> & operator++()
+		{
+			++ctrl, ++slot;
+			skipFree();
+
+			return *this;
+		}
+
+		/// Iterator comparison
+		/// @{
+		FORCE_INLINE bool operator==(const SlotIterator<U> & other) const { return slot == other.slot; }
+		FORCE_INLINE bool operator!=(const SlotIterator<U> & other) const { return slot != other.slot; }
+		/// @}
+
+		/// Access item
+		/// @{
+		FORCE_INLINE U & operator* () const { return *slot; }
+		FORCE_INLINE U * operator->() const { return slot; }
+		/// @}
+	};
+
+	/// Define iterator types
+	using Iterator		= SlotIterator<ItemT>;
+	using ConstIterator	= SlotIterator<const ItemT>;
+
+protected:
+	/// Control bytes, capacity + numSlots
+	int8 * control;
+
+	/// Item slots
+	ItemT * slots;
+
+	/// Number of slots, zero if not allocated
+	uint64 capacity;
+
+	/// Number of items
+	uint64 count;
+
+	/// Number of empty slots that can be used before growing
+	uint64 growthLeft;
+
+	/// Returns max number of items for capacity, at
+	/// least one slot must stay empty to end probing
+	static FORCE_INLINE constexpr uint64 getMaxLoad(uint64 _capacity) { return _capacity == 7 ? 6 : _capacity - _capacity / 8; }
+
+	/// Returns offset of slots in allocation
+	static FORCE_INLINE constexpr uint64 getSlotsOffset(uint64 _capacity) { return PlatformMath::alignUp(_capacity + Group::numSlots, alignof(ItemT)); }
+
+	/// Returns hash of key
+	template<typename KeyU>
+	static FORCE_INLINE uint64 getHash(const KeyU & key) { return HashT()(key); }
+
+	/// Returns bits of hash stored in control byte
+	static FORCE_INLINE int8 getH2(uint64 hash) { return int8(hash & 0x7f); }
+
+	/// Sets control byte and its clone
+	FORCE_INLINE void setControl(uint64 i, int8 h2)
+	{
+		control[i] = h2;
+		control[((i - minCapacity) & capacity) + minCapacity] = h2;
+	}
+
+	/// Allocates buffer for capacity, all slots empty
+	FORCE_INLINE void allocate(uint64 _capacity)
+	{
+		const uint64 slotsOffset = getSlotsOffset(_capacity);
+
+		uint8 * buffer = reinterpret_cast<uint8*>(getAllocator().malloc(slotsOffset + _capacity * sizeof(ItemT), bufferAlignment));
+		control		= reinterpret_cast<int8*>(buffer);
+		slots		= reinterpret_cast<ItemT*>(buffer + slotsOffset);
+		capacity	= _capacity;
+
+		PlatformMemory::memset(control, Group::EMPTY, capacity + Group::numSlots);
+		control[capacity] = Group::SENTINEL;
+
+		growthLeft = getMaxLoad(capacity) - count;
+	}
+
+	/// Destroys all items
+	FORCE_INLINE void destroyItems()
+	{
+		if (!IsTriviallyDestructible<ItemT>::value)
+			for (Iterator it = begin(); it != end(); ++it) it->~ItemT();
+	}
+
+	/// Resets to unallocated state, without freeing buffer
+	FORCE_INLINE void reset()
+	{
+		control		= Group::getEmptyControl();
+		slots		= nullptr;
+		capacity	= 0;
+		count		= 0;
+		growthLeft	= 0;
+	}
+
+	/// Frees buffer
+	FORCE_INLINE void deallocate()
+	{
+		if (capacity) getAllocator().free(control);
+		reset();
+	}
+
+	/**
+	 * Finds slot with key
+	 * 
+	 * @param [in] key search key
+	 * @param [in] hash hash of key
+	 * @return slot index, or capacity if not found
+	 */
+	template<typename KeyU>
+	FORCE_INLINE uint64 findSlot(const KeyU & key, uint64 hash) const
+	{
+		const int8 h2 = getH2(hash);
+		uint64 pos = (hash >> 7) & capacity;
+
+		for (uint64 offset = 0; ; )
+		{
+			const Group group(control + pos);
+			for (typename Group::Mask mask = group.match(h2); mask; mask = Group::next(mask))
+			{
+				const uint64 i = (pos + Group::getIndex(mask)) & capacity;
+				if (LIKELY(key == KeyOfT()(slots[i]))) return i;
+			}
+
+			// Key would be in this group
+			if (LIKELY(group.matchEmpty())) return capacity;
+
+			offset += Group::numSlots;
+			pos = (pos + offset) & capacity;
+		}
+	}
+
+	/// Returns first free slot in the probe sequence of hash
+	FORCE_INLINE uint64 findFreeSlot(uint64 hash) const
+	{
+		uint64 pos = (hash >> 7) & capacity;
+
+		for (uint64 offset = 0; ; )
+		{
+			if (const typename Group::Mask mask = Group(control + pos).matchFree())
+				return (pos + Group::getIndex(mask)) & capacity;
+
+			offset += Group::numSlots;
+			pos = (pos + offset) & capacity;
+		}
+	}
+
+	/// Moves all items to a new buffer with capacity
+	void rehash(uint64 _capacity)
+	{
+		int8 * oldControl = control;
+		ItemT * oldSlots = slots;
+		const uint64 oldCapacity = capacity;
+
+		allocate(_capacity);
+
+		for (uint64 i = 0; i < oldCapacity; ++i)
+		{
+			if (oldControl[i] >= 0)
+			{
+				const uint64 hash = getHash(KeyOfT()(oldSlots[i]));
+				const uint64 j = findFreeSlot(hash);
+				setControl(j, getH2(hash));
+
+				// Relocate item
+				if (IsTriviallyRelocatable<ItemT>::value)
+					PlatformMemory::memcpy(slots + j, oldSlots + i, sizeof(ItemT));
+				else
+				{
+					new (slots + j) ItemT(std::move(oldSlots[i]));
+					oldSlots[i].~ItemT();
+				}
+			}
+		}
+
+		if (oldCapacity) getAllocator().free(oldControl);
+	}
+
+	/// Returns smallest capacity that holds n items
+	static FORCE_INLINE uint64 getCapacityFor(uint64 n)
+	{
+		uint64 _capacity = minCapacity;
+		while (getMaxLoad(_capacity) < n) _capacity = _capacity * 2 + 1;
+		return _capacity;
+	}
+
+	/// Returns a free slot for an item with hash
+	FORCE_INLINE uint64 prepareInsert(uint64 hash)
+	{
+		uint64 i = findFreeSlot(hash);
+
+		if (UNLIKELY(growthLeft == 0 && control[i] != Group::DELETED))
+		{
+			// Grow, or just drop tombstones if at most half full
+			rehash(count < getMaxLoad(capacity) / 2 ? capacity : getCapacityFor(count + 1));
+			i = findFreeSlot(hash);
+		}
+
+		growthLeft -= control[i] == Group::EMPTY;
+		setControl(i, getH2(hash));
+		++count;
+
+		return i;
+	}
+
+	/// Destroys item in slot i and frees the slot
+	FORCE_INLINE void eraseSlot(uint64 i)
+	{
+		slots[i].~ItemT();
+		--count;
+
+		// No tombstone is needed if no group that
+		// contains this slot was ever full, since
+		// probing never went past it
+		const typename Group::Mask emptyAfter = Group(control + i).matchEmpty();
+		const typename Group::Mask emptyBefore = Group(control + ((i - Group::numSlots) & capacity)).matchEmpty();
+		if (emptyAfter && emptyBefore && Group::getIndex(emptyAfter) + Group::getNumAfterLast(emptyBefore) < Group::numSlots)
+		{
+			setControl(i, Group::EMPTY);
+			++growthLeft;
+		}
+		else
+			setControl(i, Group::DELETED);
+	}
+
+	/// Copies items of another table, same capacity
+	template<typename AllocU>
+	FORCE_INLINE void copyItems(const HashTable<ItemT, KeyOfT, HashT, AllocU> & other)
+	{
+		if (other.capacity == 0) return;
+
+		count = other.count;
+		allocate(other.capacity);
+		growthLeft = other.growthLeft;
+
+		// Same hash, same positions
+		PlatformMemory::memcpy(control, other.control, capacity + Group::numSlots);
+		if (IsTriviallyCopyable<ItemT>::value)
+			PlatformMemory::memcpy(slots, other.slots, capacity * sizeof(ItemT));
+		else
+			for (uint64 i = 0; i < capacity; ++i)
+				if (control[i] >= 0) new (slots + i) ItemT(other.slots[i]);
+	}
+
+public:
+	/// Default constructor
+	FORCE_INLINE HashTable(const AllocT & _allocator = AllocT()) :
+		AllocT(_allocator),
+		control(Group::getEmptyControl()),
+		slots(nullptr),
+		capacity(0),
+		count(0),
+		growthLeft(0) {}
+
+	/// Copy constructor
+	FORCE_INLINE HashTable(const HashTable<ItemT, KeyOfT, HashT, AllocT> & other) : HashTable(other.getAllocator())
+	{
+		copyItems(other);
+	}
+
+	/// Copy constructor with different allocator type
+	template<typename AllocU>
+	FORCE_INLINE HashTable(const HashTable<ItemT, KeyOfT, HashT, AllocU> & other) : HashTable()
+	{
+		copyItems(other);
+	}
+
+	/// Move constructor
+	FORCE_INLINE HashTable(HashTable<ItemT, KeyOfT, HashT, AllocT> && other) :
+		AllocT(other.getAllocator()),
+		control(other.control),
+		slots(other.slots),
+		capacity(other.capacity),
+		count(other.count),
+		growthLeft(other.growthLeft)
+	{
+		other.reset();
+	}
+
+	/// Copy assignment
+	FORCE_INLINE HashTable<ItemT, KeyOfT, HashT, AllocT> & operator=(const HashTable<ItemT, KeyOfT, HashT, AllocT> & other)
+	{
+		if (this != &other)
+		{
+			destroyItems();
+			deallocate();
+
+			copyItems(other);
+		}
+
+		return *this;
+	}
+
+	/// Move assignment
+	FORCE_INLINE HashTable<ItemT, KeyOfT, HashT, AllocT> & operator=(HashTable<ItemT, KeyOfT, HashT, AllocT> && other)
+	{
+		if (this != &other)
+		{
+			destroyItems();
+			deallocate();
+
+			getAllocator()	= other.getAllocator();
+			control			= other.control;
+			slots			= other.slots;
+			capacity		= other.capacity;
+			count			= other.count;
+			growthLeft		= other.growthLeft;
+
+			other.reset();
+		}
+
+		return *this;
+	}
+
+	/// Destructor
+	FORCE_INLINE ~HashTable()
+	{
+		destroyItems();
+		deallocate();
+	}
+
+	/// Returns allocator policy
+	/// @{
+	FORCE_INLINE AllocT &		getAllocator()			{ return *this; }
+	FORCE_INLINE const AllocT &	getAllocator() const	{ return *this; }
+	/// @}
+
+	/// Returns number of items
+	FORCE_INLINE uint64 getCount() const { return count; }
+
+	/// Returns number of slots
+	FORCE_INLINE uint64 getCapacity() const { return capacity; }
+
+	/// Returns true if table is empty
+	FORCE_INLINE bool isEmpty() const { return count == 0; }
+
+	/// Returns control bytes, capacity + numSlots
+	FORCE_INLINE const int8 * getControl() const { return control; }
+
+	/// Returns item slots
+	FORCE_INLINE const ItemT * getSlots() const { return slots; }
+
+	/// STL compliant iterators
+	/// @{
+	FORCE_INLINE Iterator begin()
+	{
+		Iterator it(control, slots);
+		it.skipFree();
+		return it;
+	}
+	FORCE_INLINE ConstIterator begin() const
+	{
+		ConstIterator it(control, slots);
+		it.skipFree();
+		return it;
+	}
+
+	FORCE_INLINE Iterator		end()		{ return Iterator(control + capacity, slots + capacity); }
+	FORCE_INLINE ConstIterator	end() const	{ return ConstIterator(control + capacity, slots + capacity); }
+	/// @}
+
+	/**
+	 * Find item with key. Key may be of any type
+	 * that can be compared with the key of the
+	 * items and hashes to the same value
+	 * 
+	 * @param [in] key search key
+	 * @return item iterator, end() if not found
+	 * @{
+	 */
+	template<typename KeyU>
+	FORCE_INLINE Iterator find(const KeyU & key)
+	{
+		const uint64 i = findSlot(key, getHash(key));
+		return Iterator(control + i, slots + i);
+	}
+	template<typename KeyU>
+	FORCE_INLINE ConstIterator find(const KeyU & key) const
+	{
+		const uint64 i = findSlot(key, getHash(key));
+		return ConstIterator(control + i, slots + i);
+	}
+	/// @}
+
+	/// Returns true if an item with key exists
+	template<typename KeyU>
+	FORCE_INLINE bool contains(const KeyU & key) const
+	{
+		return findSlot(key, getHash(key)) != capacity;
+	}
+
+	/**
+	 * Finds item with key, or constructs a new one
+	 * with the given arguments
+	 * 
+	 * @param [in] key search key
+	 * @param [in] args arguments of ItemT constructor
+	 * @return ref to found or inserted item
+	 */
+	template<typename KeyU, typename ... ArgsT>
+	FORCE_INLINE ItemT & findOrEmplace(const KeyU & key, ArgsT && ... args)
+	{
+		const uint64 hash = getHash(key);
+		uint64 i = findSlot(key, hash);
+
+		if (i == capacity)
+		{
+			i = prepareInsert(hash);
+			new (slots + i) ItemT(std::forward<ArgsT>(args)...);
+		}
+
+		return slots[i];
+	}
+
+	/**
+	 * Removes item with key
+	 * 
+	 * @param [in] key search key
+	 * @return true if item was found
+	 */
+	template<typename KeyU>
+	FORCE_INLINE bool remove(const KeyU & key)
+	{
+		const uint64 i = findSlot(key, getHash(key));
+		if (i == capacity) return false;
+
+		eraseSlot(i);
+		return true;
+	}
+
+	/**
+	 * Calls a function on every item, scanning the
+	 * control bytes one group at a time
+	 * 
+	 * @param [in] func function called as func(item)
+	 */
+	template<typename FuncT>
+	FORCE_INLINE void forEach(FuncT && func) const
+	{
+		for (uint64 i = 0; i < capacity; i += Group::numSlots)
+			for (typename Group::Mask mask = Group(control + i).matchFull(); mask; mask = Group::next(mask))
+			{
+				// Skip sentinel and clones
+				const uint64 j = i + Group::getIndex(mask);
+				if (j >= capacity) break;
+
+				func(static_cast<const ItemT&>(slots[j]));
+			}
+	}
+
+	/**
+	 * Removes all items that satisfy a predicate,
+	 * scanning the control bytes one group at a time
+	 * 
+	 * @param [in] pred predicate called as pred(item)
+	 * @return number of removed items
+	 */
+	template<typename PredT>
+	FORCE_INLINE uint64 removeIf(PredT && pred)
+	{
+		const uint64 oldCount = count;
+
+		for (uint64 i = 0; i < capacity; i += Group::numSlots)
+			for (typename Group::Mask mask = Group(control + i).matchFull(); mask; mask = Group::next(mask))
+			{
+				const uint64 j = i + Group::getIndex(mask);
+				if (j >= capacity) break;
+
+				if (pred(static_cast<const ItemT&>(slots[j]))) eraseSlot(j);
+			}
+
+		return oldCount - count;
+	}
+
+	/**
+	 * Makes room for n items without growing
+	 * 
+	 * @param [in] n number of items
+	 */
+	FORCE_INLINE void reserve(uint64 n)
+	{
+		if (n > count + growthLeft) rehash(getCapacityFor(n));
+	}
+
+	/// Destroys all items, keeps buffer
+	FORCE_INLINE void empty()
+	{
+		if (capacity == 0) return;
+
+		destroyItems();
+		count = 0;
+
+		PlatformMemory::memset(control, Group::EMPTY, capacity + Group::numSlots);
+		control[capacity] = Group::SENTINEL;
+		growthLeft = getMaxLoad(capacity);
+	}
+};
\ No newline at end of file
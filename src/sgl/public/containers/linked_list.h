@@ -2,7 +2,7 @@
 
 #include "core_types.h"
 #include "hal/platform_memory.h"
-#include "hal/malloc_ansi.h"
+#include "hal/malloc_policy.h"
 #include "templates/const_ref.h"
 #include "templates/is_trivially_copyable.h"
 
@@ -88,9 +88,10 @@ template<typename T> using LinkRef = Link<T>*;
 /**
  * @class LinkedList containers/linked_list.h
  * Implementation of a traditional linked list container
+ * Links are allocated with the allocator policy AllocT
  */
-template<typename T, typename AllocT = MallocAnsi>
-class GCC_ALIGN(32) LinkedList
+template<typename T, typename AllocT = HeapAllocator>
+class GCC_ALIGN(32) LinkedList : protected AllocT
 {
 	template<typename U, typename AllocU>
 	friend class LinkedList;
@@ -141,10 +142,6 @@ public:
 	using ConstIterator	= LinkedListIterator<T>;
 
 protected:
-	/// @biref Allocator used to allocate new links
-	AllocT * allocator;
-	bool bHasOwnAllocator;
-
 	/// Head of the list
 	LinkRef<T> head;
 
@@ -156,28 +153,22 @@ protected:
 
 public:
 	/// Default-constructor, empty list
-	FORCE_INLINE LinkedList(AllocT * _allocator = reinterpret_cast<AllocT*>(gMalloc)) :
-		allocator(_allocator),
-		bHasOwnAllocator(_allocator == nullptr),
+	FORCE_INLINE LinkedList(const AllocT & _allocator = AllocT()) :
+		AllocT(_allocator),
 		head(nullptr),
 		tail(nullptr),
-		count(0)
-	{
-		// Create own allocator
-		if (bHasOwnAllocator)
-			allocator = new AllocT;
-	}
+		count(0) {}
 
 protected:
 	/// Creates a new link with the provided data
 	FORCE_INLINE LinkRef<T> createLink(typename ConstRef<T>::Type data, LinkRef<T> next = nullptr, LinkRef<T> prev = nullptr)
 	{
-		return new (reinterpret_cast<LinkRef<T>>(allocator->malloc(sizeof(Link<T>)))) Link<T>(data, next, prev);
+		return new (reinterpret_cast<LinkRef<T>>(getAllocator().malloc(sizeof(Link<T>), alignof(Link<T>)))) Link<T>(data, next, prev);
 	}
 
 public:
 	/// Copy constructor
-	FORCE_INLINE LinkedList(const LinkedList<T, AllocT> & other) : LinkedList(nullptr)
+	FORCE_INLINE LinkedList(const LinkedList<T, AllocT> & other) : LinkedList(other.getAllocator())
 	{
 		if (other.head)
 		{
@@ -199,7 +190,7 @@ public:
 
 	/// Copy constructor with different allocator type
 	template<typename AllocU>
-	FORCE_INLINE LinkedList(const LinkedList<T, AllocU> & other) : LinkedList(nullptr)
+	FORCE_INLINE LinkedList(const LinkedList<T, AllocU> & other) : LinkedList()
 	{
 		if (other.head)
 		{
@@ -221,13 +212,11 @@ public:
 
 	/// Move constructor
 	FORCE_INLINE LinkedList(LinkedList<T, AllocT> && other) :
-		allocator(other.allocator),
-		bHasOwnAllocator(other.bHasOwnAllocator),
+		AllocT(other.getAllocator()),
 		head(other.head),
 		tail(other.tail),
 		count(other.count)
 	{
-		other.bHasOwnAllocator = false;
 		other.head = other.tail = nullptr;
 	}
 
@@ -292,14 +281,13 @@ public:
 		// empty self first
 		empty();
 
-		allocator			= other.allocator;
-		bHasOwnAllocator	= other.bHasOwnAllocator;
-		head				= other.head;
-		tail				= other.tail;
-		count				= other.count;
+		getAllocator()	= other.getAllocator();
+		head			= other.head;
+		tail			= other.tail;
+		count			= other.count;
 
-		other.bHasOwnAllocator = false;
 		other.head = other.tail = nullptr;
+		return *this;
 	}
 
 	/// Destructor
@@ -307,12 +295,14 @@ public:
 	{
 		// Empty list
 		empty();
-
-		// Delete own allocator
-		if (bHasOwnAllocator)
-			delete allocator;
 	}
 
+	/// Returns allocator policy
+	/// @{
+	FORCE_INLINE AllocT &		getAllocator()			{ return *this; }
+	FORCE_INLINE const AllocT &	getAllocator() const	{ return *this; }
+	/// @}
+
 	/// Return list length
 	/// @{
 	FORCE_INLINE uint64 getCount() const	{ return count; }
@@ -427,7 +417,7 @@ public:
 			tail = tail->prev;
 
 			removed->~Link();
-			allocator->free(removed);
+			getAllocator().free(removed);
 
 			return true;
 		}
@@ -457,7 +447,7 @@ public:
 			head = head->next;
 
 			removed->~Link();
-			allocator->free(removed);
+			getAllocator().free(removed);
 
 			return true;
 		}
@@ -487,7 +477,7 @@ public:
 
 			// Destroy link
 			it->~Link();
-			allocator->free(it);
+			getAllocator().free(it);
 		}
 
 		// Make sure tail is null as well
@@ -3,7 +3,7 @@
 #include "core_types.h"
 #include "pair.h"
 #include "binary_tree.h"
-#include "hal/malloc_binned.h"
+#include "hal/malloc_policy.h"
 
 /**
  * @class Map containers/tree_map.h
@@ -14,7 +14,7 @@
  * are sorted and all basic operations (insertion,
  * deletion, search) are O(log(n))
  */
-template<typename KeyT, typename ValT, typename CompareT = Compare, typename AllocT = MallocBinned>
+template<typename KeyT, typename ValT, typename CompareT = Compare, typename AllocT = HeapAllocator>
 class Map
 {
 public:
@@ -38,7 +38,7 @@ protected:
 
 public:
 	/// Default constructor
-	FORCE_INLINE Map(AllocT * allocator = reinterpret_cast<AllocT*>(gMalloc)) :
+	FORCE_INLINE Map(const AllocT & allocator = AllocT()) :
 		tree(allocator) {}
 
 	/**
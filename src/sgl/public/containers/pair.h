@@ -12,25 +12,11 @@ template<typename A, typename B>
 class Pair
 {
 public:
-	union
-	{
-		struct {
-			/// First element
-			A first;
+	/// First element, or key
+	A first;
 
-			/// Second element
-			B second;
-		};
-
-		struct {
-			/// Pair key
-			A key;
-
-			/// Pair value
-			B val;
-		};
-	};
-	
+	/// Second element, or value
+	B second;
 
 public:
 	/// Pair constructor
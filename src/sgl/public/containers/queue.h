@@ -2,45 +2,46 @@
 
 #include "core_types.h"
 #include "hal/platform_memory.h"
-#include "hal/malloc_ansi.h"
+#include "hal/malloc_policy.h"
 #include "templates/const_ref.h"
 #include "templates/is_trivially_copyable.h"
+#include "templates/is_trivially_relocatable.h"
+
+/// A client node of a queue
+template<typename T>
+struct GCC_ALIGN(32) QueueClient
+{
+	/// Next client in queue
+	QueueClient * next;
+
+	/// Data carried by the client
+	T data;
+
+	/// Default constructor
+	FORCE_INLINE QueueClient(typename ConstRef<T>::Type & _data, QueueClient * _next = nullptr) :
+		data(_data),
+		next(nullptr) {}
+};
 
 /**
  * @class Queue containers/queue.h
  * 
  * A Queue class implemented as a
- * singly-linked list
+ * singly-linked list. Clients are allocated
+ * with the allocator policy AllocT
  */
-template <typename T, typename AllocT = MallocAnsi>
-class GCC_ALIGN(32) Queue
+template <typename T, typename AllocT = HeapAllocator>
+class GCC_ALIGN(32) Queue : protected AllocT
 {
 	// Sometimes C++ doesn't really make sense ...
 	template<typename, typename> friend class Queue;
 
-protected:
-	/// A client node
-	struct GCC_ALIGN(32) Client
-	{
-		/// Next client in queue
-		Client * next;
-
-		/// Data carried by the client
-		T data;
-
-		/// Default constructor
-		FORCE_INLINE Client(typename ConstRef<T>::Type & _data, Client * _next = nullptr) :
-			data(_data),
-			next(nullptr) {}
-	};
-
-	using ClientRef = Client*;
+public:
+	/// Client node type
+	using Client	= QueueClient<T>;
+	using ClientRef	= Client*;
 
 protected:
-	/// Allocator in use
-	AllocT * allocator;
-	bool bHasOwnAllocator;
-
 	/// First client
 	ClientRef first;
 
@@ -52,78 +53,78 @@ protected:
 
 public:
 	/// Default constructor
-	FORCE_INLINE Queue(AllocT * _allocator = reinterpret_cast<AllocT*>(gMalloc)) :
-		allocator(_allocator),
-		bHasOwnAllocator(!_allocator),
+	FORCE_INLINE Queue(const AllocT & _allocator = AllocT()) :
+		AllocT(_allocator),
 		first(nullptr),
 		last(nullptr),
-		numClients(0)
-	{
-		// Create a new allocator for the queue
-		if (bHasOwnAllocator)
-			allocator = new AllocT;
-	}
+		numClients(0) {}
 
 protected:
 	/// Construct client node
 	FORCE_INLINE ClientRef createClient(typename ConstRef<T>::Type data)
 	{
-		return new (reinterpret_cast<ClientRef>(allocator->malloc(sizeof(Client)))) Client(data);
+		return new (reinterpret_cast<ClientRef>(getAllocator().malloc(sizeof(Client), alignof(Client)))) Client(data);
 	}
 
-public:
-	/// Copy constructor
-	FORCE_INLINE Queue(const Queue<T, AllocT> & other) : Queue(nullptr)
+	/// Unlinks first client and returns it
+	FORCE_INLINE ClientRef unlinkFirst()
 	{
-		if (other.first)
-		{
-			// Set first
-			first = last = createClient(other.first->data);
+		ClientRef client = first;
 
-			// Very costly, we have to reinsert all the clients
-			ClientRef it = other.first->next;
-			while (it)
-			{
-				last = last->next = createClient(it->data);
-				it = it->next;
-			}
-		}
+		// Link next
+		if ((first = client->next) == nullptr)
+			last = nullptr;
 
-		// Set num clients
-		numClients = other.numClients;
+		--numClients;
+		return client;
 	}
 
-	/// Copy constructor with different allocator type
+	/// Destroy client node
+	FORCE_INLINE void destroyClient(ClientRef client)
+	{
+		client->~Client();
+		getAllocator().free(client);
+	}
+
+	/// Appends copies of the clients of another
+	/// queue, clients are allocated in batches
 	template<typename AllocU>
-	FORCE_INLINE Queue(const Queue<T, AllocU> & other) : Queue(nullptr)
+	FORCE_INLINE void copyClients(const Queue<T, AllocU> & other)
 	{
-		if (other.first)
-		{
-			// Set first
-			first = last = createClient(other.first->data);
+		MallocBatch<AllocT> batch(&getAllocator(), sizeof(Client), other.numClients, alignof(Client));
 
-			// Very costly, we have to reinsert all the clients
-			typename Queue<T, AllocU>::ClientRef it = other.first->next;
-			while (it)
-			{
-				last = last->next = createClient(it->data);
-				it = it->next;
-			}
+		for (typename Queue<T, AllocU>::ClientRef it = other.first; it; it = it->next)
+		{
+			ClientRef client = new (reinterpret_cast<ClientRef>(batch.malloc())) Client(it->data);
+			if (last) last = last->next = client;
+			else first = last = client;
 		}
 
 		// Set num clients
 		numClients = other.numClients;
 	}
 
+public:
+	/// Copy constructor
+	FORCE_INLINE Queue(const Queue<T, AllocT> & other) : Queue(other.getAllocator())
+	{
+		copyClients(other);
+	}
+
+	/// Copy constructor with different allocator type
+	template<typename AllocU>
+	FORCE_INLINE Queue(const Queue<T, AllocU> & other) : Queue()
+	{
+		copyClients(other);
+	}
+
 	/// Move constructor
 	FORCE_INLINE Queue(Queue<T, AllocT> && other) :
-		allocator(other.allocator),
-		bHasOwnAllocator(other.bHasOwnAllocator),
+		AllocT(other.getAllocator()),
 		first(other.first),
 		last(other.last),
 		numClients(other.numClients)
 	{
-		other.bHasOwnAllocator = false;
 		other.first = other.last = nullptr;
 	}
 
@@ -136,22 +137,8 @@ public:
 		// @todo Instead of 'empty and allocate' new links
 		// use existing ones, just copy the new data
 
-		if (other.first)
-		{
-			// Set first
-			first = last = createClient(other.first->data);
-
-			// Very costly, we have to reinsert all the clients
-			ClientRef it = other.first->next;
-			while (it)
-			{
-				last = last->next = createClient(it->data);
-				it = it->next;
-			}
-		}
-
-		// Set num clients
-		numClients = other.numClients;
+		copyClients(other);
+		return *this;
 	}
 
 	/// Copy assignment with different allocator type
@@ -164,22 +151,8 @@ public:
 		// @todo Instead of 'empty and allocate' new links
 		// use existing ones, just copy the new data
 		
-		if (other.first)
-		{
-			// Set first
-			first = last = createClient(other.first->data);
-
-			// Very costly, we have to reinsert all the clients
-			typename Queue<T, AllocU>::ClientRef it = other.first->next;
-			while (it)
-			{
-				last = last->next = createClient(it->data);
-				it = it->next;
-			}
-		}
-
-		// Set num clients
-		numClients = other.numClients;
+		copyClients(other);
+		return *this;
 	}
 
 	/// Move assignment
@@ -188,14 +161,13 @@ public:
 		// empty self first
 		empty();
 
-		allocator			= other.allocator;
-		bHasOwnAllocator	= other.bHasOwnAllocator;
-		first				= other.first;
-		last				= other.last;
-		numClients			= other.numClients;
+		getAllocator()	= other.getAllocator();
+		first			= other.first;
+		last			= other.last;
+		numClients		= other.numClients;
 
-		other.bHasOwnAllocator = false;
 		other.first = other.last = nullptr;
+		return *this;
 	}
 
 	/// Destructor
@@ -203,11 +175,13 @@ public:
 	{
 		// Empty queue
 		empty();
-
-		// Delete own allocator
-		if (bHasOwnAllocator)
-			delete allocator;
 	}
+
+	/// Returns allocator policy
+	/// @{
+	FORCE_INLINE AllocT &		getAllocator()			{ return *this; }
+	FORCE_INLINE const AllocT &	getAllocator() const	{ return *this; }
+	/// @}
 	
 	/// Returns number of clients in queue
 	FORCE_INLINE uint64 getLength() const { return numClients; }
@@ -242,16 +216,7 @@ public:
 	{
 		if (first)
 		{
-			// Dealloc node
-			ClientRef next = first->next;
-			allocator->free(first);
-
-			// Link next
-			if (next)
-				first = next;
-			else
-				first = last = nullptr;
-
+			destroyClient(unlinkFirst());
 			return true;
 		}
 
@@ -261,9 +226,23 @@ public:
 	{
 		if (first)
 		{
-			// Get data out
-			moveOrCopy(data, first->data);
-			return pop();
+			ClientRef client = unlinkFirst();
+
+			if (IsTriviallyRelocatable<T>::value)
+			{
+				// Relocate data out, client is
+				// dealloced without destroying it
+				data.~T();
+				PlatformMemory::memcpy(&data, &client->data, sizeof(T));
+				getAllocator().free(client);
+			}
+			else
+			{
+				data = std::move(client->data);
+				destroyClient(client);
+			}
+
+			return true;
 		}
 
 		return false;
@@ -280,11 +259,12 @@ public:
 			first = first->next;
 
 			// Destroy link
-			allocator->free(it);
+			destroyClient(it);
 		}
 
 		// Make sure last is null as well
 		first = last = nullptr;
+		numClients = 0;
 	}
 	FORCE_INLINE void flush() { empty(); }
 	/// @}
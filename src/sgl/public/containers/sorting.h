@@ -3,7 +3,7 @@
 #include "core_types.h"
 #include "containers.h"
 #include "templates/const_ref.h"
-#include "templates/is_trivially_copyable.h"
+#include "templates/is_trivially_relocatable.h"
 #include "templates/functional.h"
 
 namespace Container
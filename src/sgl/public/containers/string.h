@@ -3,18 +3,23 @@
 #include "containers_fwd.h"
 #include "array.h"
 #include "hal/platform_string.h"
+#include "templates/hash.h"
+
+#define STRING_INLINE_SIZE 32	// Bytes stored inside the string, including null terminator
 
 /**
  * @class String containers/string.h
  * @brief Base string class
  * 
- * A dynamic size string
+ * A dynamic size string. Strings up to
+ * STRING_INLINE_SIZE - 1 characters are stored
+ * inline and don't allocate
  */
 class String
 {
 protected:
 	/// Underlying data
-	Array<ansichar> data;
+	Array<ansichar, InlineAllocator<STRING_INLINE_SIZE>> data;
 
 public:
 	/// Default constructor
@@ -41,6 +46,44 @@ public:
 		}
 	}
 
+	/// Copy constructor
+	FORCE_INLINE String(const String & other) :
+		data(other.data)
+	{
+		// Terminator is not part of the array
+		data.buffer[data.count] = '\0';
+	}
+
+	/// Move constructor
+	FORCE_INLINE String(String && other) :
+		data(std::move(other.data))
+	{
+		// Inline buffers are copied without terminator
+		data.buffer[data.count] = '\0';
+	}
+
+	/// Copy assignment
+	FORCE_INLINE String & operator=(const String & other)
+	{
+		// Array keeps the old buffer if it holds the
+		// characters, it may miss the terminator
+		data = other.data;
+		data.resizeIfNecessary(data.count + 1);
+		data.buffer[data.count] = '\0';
+
+		return *this;
+	}
+
+	/// Move assignment
+	FORCE_INLINE String & operator=(String && other)
+	{
+		data = std::move(other.data);
+		data.resizeIfNecessary(data.count + 1);
+		data.buffer[data.count] = '\0';
+
+		return *this;
+	}
+
 	/// Provides access to underying data
 	/// @{
 	FORCE_INLINE ansichar *			operator*()			{ return data.buffer; }
@@ -56,6 +99,9 @@ public:
 	/// Returns string length (without null terminating character)
 	FORCE_INLINE uint64 getLength() const { return data.count; }
 
+	/// Returns hash of the content, same as for a c-string
+	friend FORCE_INLINE uint64 getHash(const String & string) { return hashBytes(*string, string.getLength()); }
+
 	/**
 	 * Compare with another string
 	 * 
@@ -71,8 +117,8 @@ public:
 
 	/// Like @copydoc compare() but case insensitive
 	/// @{
-	FORCE_INLINE int32 comparei(const String & s) const		{ return PlatformString::strcmp(**this, *s); }
-	FORCE_INLINE int32 comparei(const ansichar * s) const	{ return PlatformString::strcmp(**this, s); }
+	FORCE_INLINE int32 comparei(const String & s) const		{ return PlatformString::strcmpi(**this, *s); }
+	FORCE_INLINE int32 comparei(const ansichar * s) const	{ return PlatformString::strcmpi(**this, s); }
 
 	friend FORCE_INLINE int32 comparei(const ansichar * s1, const String & s2) { return s2.comparei(s1); }
 	/// @}
@@ -110,6 +156,8 @@ public:
 		data.resizeIfNecessary(data.count + 2);
 		data.buffer[data.count++] = c;
 		data.buffer[data.count] = '\0';
+
+		return *this;
 	}
 
 	/**
@@ -122,9 +170,11 @@ public:
 	 */
 	FORCE_INLINE String & append(const ansichar * s, sizet n)
 	{
-		data.resizeIfNecessary(data.count + n);
+		data.resizeIfNecessary(data.count + n + 1);
 		PlatformMemory::memcpy(data.buffer + data.count, s, n);
 		data.buffer[data.count += n] = '\0';
+
+		return *this;
 	}
 	FORCE_INLINE String & operator+=(const ansichar * s)	{ return append(s, PlatformString::strlen(s)); }
 	FORCE_INLINE String & operator+=(const String & s)		{ return append(*s, s.data.count); }
@@ -17,6 +17,23 @@
  */
 class EngineLoop
 {
+protected:
+	/// Number of ticks between two memory trims
+	static constexpr uint64 trimInterval = 1024;
+
+	/// Number of ticks between two allocator stats snapshots
+	static constexpr uint64 memoryStatsInterval = 4096;
+
+	/// Size of a buffer of the per-frame allocator
+	static constexpr sizet frameMallocSize = 16 * 1024 * 1024;
+
+	/// Ticks since application start
+	uint64 numTicks = 0;
+
+	/// Allocator stats are appended to this file,
+	/// opened if SGL_MALLOC_STATS is set to a path
+	FILE * memoryStatsFile = nullptr;
+
 public:
 	/// @brief Default-constructor
 	EngineLoop() = default;
@@ -20,6 +20,7 @@
 
 #include "hal/platform_crt.h"
 #include "hal/platform_memory.h"
+#include "hal/malloc_linear.h"
 
 #include "templates/is_integral.h"
 #include "templates/is_pointer.h"
@@ -38,6 +39,8 @@
 #include "containers/linked_list.h"
 #include "containers/queue.h"
 #include "containers/map.h"
+#include "containers/hash_map.h"
+#include "containers/hash_set.h"
 #include "containers/string.h"
 #include "containers/containers.h"
 
@@ -115,6 +115,34 @@ struct GenericPlatformMath
 		return out;
 	}
 	/** @} */
+
+	/**
+	 * @brief Count leading zero bits
+	 * 
+	 * @param n input value, must not be 0
+	 * 
+	 * @return number of zero bits before most significant one
+	 */
+	static CONSTEXPR FORCE_INLINE uint32 getLeadingZeros(uint64 n)
+	{
+		uint32 out = 64;
+		while (n) n >>= 1, --out;
+		return out;
+	}
+
+	/**
+	 * @brief Count trailing zero bits
+	 * 
+	 * @param n input value, must not be 0
+	 * 
+	 * @return number of zero bits after least significant one
+	 */
+	static CONSTEXPR FORCE_INLINE uint32 getTrailingZeros(uint64 n)
+	{
+		uint32 out = 0;
+		while (!(n & 1)) n >>= 1, ++out;
+		return out;
+	}
 };
 
 /// Float-32 specialization
@@ -2,6 +2,7 @@
 
 #include "core_types.h"
 #include <string.h>
+#include <stdlib.h>
 #include "templates/enable_if.h"
 #include "templates/is_pointer.h"
 
@@ -118,6 +119,82 @@ public:
 		}
 	}
 
+	/// @brief Returns size of a virtual memory page
+	static FORCE_INLINE sizet getPageSize() { return 0x1000; }
+
+	/**
+	 * @brief Give back physical pages to the OS, the
+	 * address range stays reserved. Contents of the
+	 * pages are lost
+	 * 
+	 * @param [in]	ptr		page aligned address
+	 * @param [in]	size	size of the range in Bytes
+	 * 
+	 * @return @c true if pages were released
+	 */
+	static FORCE_INLINE bool decommit(void * ptr, sizet size) { return false; }
+
+	/**
+	 * @brief Map a range of virtual memory
+	 * 
+	 * @param [in]	size		size of the range in Bytes
+	 * @param [in]	alignment	alignment of the range, at least a page
+	 * @param [in]	bHugePages	if true, back the range with huge pages if possible
+	 * 
+	 * @return address of the range, null on failure
+	 */
+	static FORCE_INLINE void * map(sizet size, sizet alignment = 0, bool bHugePages = false)
+	{
+		alignment = alignment > getPageSize() ? alignment : getPageSize();
+		return ::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+	}
+
+	/**
+	 * @brief Unmap a range returned by @ref map()
+	 * 
+	 * @param [in]	ptr		address of the range
+	 * @param [in]	size	size of the range in Bytes
+	 * 
+	 * @return @c true on success
+	 */
+	static FORCE_INLINE bool unmap(void * ptr, sizet size)
+	{
+		::free(ptr);
+		return true;
+	}
+
+	/**
+	 * @brief Resize a range returned by @ref map(),
+	 * moving it if necessary. Contents are preserved
+	 * without copying
+	 * 
+	 * @param [in]	ptr		address of the range
+	 * @param [in]	oldSize	current size of the range
+	 * @param [in]	newSize	required size
+	 * 
+	 * @return new address of the range, null if not possible
+	 */
+	static FORCE_INLINE void * remap(void * ptr, sizet oldSize, sizet newSize) { return nullptr; }
+
+	/// @brief Returns number of NUMA nodes
+	static FORCE_INLINE uint32 getNumNodes() { return 1; }
+
+	/// @brief Returns NUMA node of the cpu running the calling thread
+	static FORCE_INLINE uint32 getCurrentNode() { return 0; }
+
+	/**
+	 * @brief Ask the OS to back a range with pages
+	 * of a NUMA node. Only a preference, the OS may
+	 * still use other nodes if the node is full
+	 * 
+	 * @param [in]	ptr		page aligned address
+	 * @param [in]	size	size of the range in Bytes
+	 * @param [in]	node	NUMA node index
+	 * 
+	 * @return @c true if the policy was set
+	 */
+	static FORCE_INLINE bool bindToNode(void * ptr, sizet size, uint32 node) { return false; }
+
 	/// @brief Return the default allocator
 	static class Malloc * baseMalloc();
 };
@@ -2,6 +2,8 @@
 
 #include "platform_memory.h"
 
+#define MALLOC_ANSI_MMAP_THRESHOLD (1024 * 1024)	// Blocks larger than this are mapped by malloc, 1 MB
+
 /**
  * @class MallocAnsi hal/malloc_ansi.h
  * @brief Default allocation class
@@ -9,6 +11,9 @@
 class MallocAnsi : public Malloc
 {
 public:
+	/// Default constructor
+	MallocAnsi();
+
 	/// @copydoc Malloc::malloc()
 	virtual void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
 
@@ -20,5 +25,8 @@ public:
 
 	/// @copydoc Malloc::getAllocSize()
 	virtual bool getAllocSize(void * original, sizet & n) override;
+
+	/// @copydoc Malloc::trim()
+	virtual void trim() override;
 };
 
@@ -3,17 +3,31 @@
 #include "core_types.h"
 #include "platform_memory.h"
 #include "platform_math.h"
+#include "platform_atomics.h"
+#include "platform_threads.h"
+#include "critical_section.h"
 #include "malloc_pool.h"
+#include "malloc_mapped.h"
 #include "containers/linked_list.h"
 #include "containers/binary_tree.h"
 #include "containers/pair.h"
 
-#define MALLOC_BINNED_POOL_SIZE 8 * 1024 * 1024		// Fixed pool size, 4 MB
-#define MALLOC_BINNED_BLOCK_MIN_SIZE 32				// Min block size (block size for first bucket), 32 B
-#define MALLOC_BINNED_BLOCK_MAX_SIZE 1024 * 1024	// Max block size (block size for last bucket), 1 MB
-#define MALLOC_BINNED_BLOCK_ALIGNMENT 0x20			// Block alignment inside pool
-#define MALLOC_BINNED_NUM_BUCKETS 16				// Should change according to min and max bucket size
+#define MALLOC_BINNED_POOL_SIZE (8 * 1024 * 1024)	// Fixed pool size, 8 MB
+#define MALLOC_BINNED_BLOCK_MIN_SIZE 8				// Min block size (block size for first bucket), 8 B
+#define MALLOC_BINNED_BLOCK_MAX_SIZE (1024 * 1024)	// Max block size (block size for last bucket), 1 MB
+#define MALLOC_BINNED_BLOCK_ALIGNMENT 0x8			// Min block alignment inside pool
+#define MALLOC_BINNED_NUM_BUCKETS 64				// Should change according to min and max bucket size
 #define MALLOC_BINNED_POOL_ALIGNMENT 0x1000			// 4 KB, size of a page
+#define MALLOC_BINNED_ADDRESS_BITS 48				// Significant bits of a virtual address
+#define MALLOC_BINNED_PAGE_MAP_ROOT_BITS 12			// Bits used to index the root of the page map
+#define MALLOC_BINNED_CACHE_MAX_BLOCKS 64			// Max number of blocks in a thread cache bin
+#define MALLOC_BINNED_CACHE_MAX_BYTES (64 * 1024)	// Max size of a thread cache bin, 64 KB
+#define MALLOC_BINNED_TRIM_RETAINED_POOLS 1			// Free pools per bucket kept mapped by trim
+#define MALLOC_BINNED_POOL_HUGE_PAGES 0				// Back pools with huge pages, trades RSS for TLB reach and commits pools eagerly
+#define MALLOC_BINNED_OCCUPANCY_SLOT_SIZE 0x1000	// Granularity of pool occupancy bitmaps, 4 KB
+#define MALLOC_BINNED_NUMA 1						// Keep separate pools for each NUMA node
+#define MALLOC_BINNED_NUMA_BIND 1					// Bind pool pages to their node, otherwise rely on first touch
+#define MALLOC_BINNED_MAX_NODES 4					// Max number of NUMA nodes with their own pools
 
 /**
  * @class MallocBinned hal/malloc_binned.h
@@ -21,25 +35,69 @@
  * Allocator backed by memory pools
  * 
  * A binned allocator uses buckets of memory pools
- * organized by block size.
+ * organized by block size. Up to 32 B, block sizes
+ * grow in steps of 8 B; above, each power of two is
+ * split in four size classes (e.g. 40, 48, 56, 64).
+ * Blocks have no header, so a request wastes at
+ * most 25% of its block.
+ * 
+ * Pool buffers are aligned to the pool size, thus
+ * blocks are aligned to the largest power of two
+ * that divides their size. Over-aligned requests
+ * are served by the first bucket whose block size
+ * is a multiple of the alignment.
  * 
  * When an allocation request is made, the request
  * is forwarded to the appropriate bucket and the
  * first free pool is queried for a free block. If
  * all pools are exahusted, a new pool is created
  * and pushed to the front of the list (for future
- * allocations).
+ * allocations). Buckets have no pools until they
+ * are first used.
  * 
  * If the allocation request exceeds the maximum
  * block size, a backup allocator is used instead.
+ * By default it maps large blocks directly from
+ * the OS, backed by huge pages (see MallocMapped).
+ * Pool buffers are mapped too, but with regular
+ * pages by default, so that pages are committed
+ * as blocks are used.
+ * 
+ * The allocator is thread-safe. Each thread owns a
+ * cache of free blocks for each bucket (a magazine)
+ * which serves most requests without locking. When
+ * a cache bin runs empty, a batch of blocks is moved
+ * from the bucket pools while holding the bucket lock.
+ * When it fills up, a batch of blocks is pushed on
+ * the remote free lists of their pools, which is
+ * lock-free; the pools reclaim them the next time
+ * they run out of blocks.
+ * 
+ * Pool buffers are aligned to their own size, so
+ * that the pool that alloc'd a block can be found
+ * in constant time by masking the block address.
+ * A two-level page map translates the masked address
+ * to the pool, much like a page table. If no such
+ * pool is found, we assume that the block was
+ * allocated using the backup allocator.
+ * 
+ * The red-black tree of pools, using the pool
+ * initial address as key, is only used as a
+ * fallback for pools that could not be registered
+ * in the page map
+ * 
+ * Pools are never released implicitly. @ref trim()
+ * decommits the pages of fully free pools, and
+ * releases them once more than a given number of
+ * free pools accumulate in the same bucket
  * 
- * The allocator also mantains a red-black tree of
- * the pools using the pool initial address as key.
- * This allows us to quickly locate the pool that
- * alloc'd a block, for deallocating it or determine
- * is allocation size. If no such pool is found, we
- * assume that the blocks was allocated using the
- * backup allocator
+ * On NUMA systems each node has its own pools in
+ * each bucket. A thread allocates from the pools of
+ * the node it runs on when it first allocates, and
+ * pool pages are bound to that node when the pool
+ * is created. Blocks freed by a thread on another
+ * node are reused by that thread. The topology can
+ * be overridden with @ref setTopology()
  */
 class MallocBinned : public Malloc
 {
@@ -53,112 +111,478 @@ protected:
 	using PoolNodeRef	= PoolNode*;
 	/// @}
 
+	/// Page map constants
+	/// @{
+	static constexpr uint32 poolShift		= PlatformMath::getNextPowerOf2Index(MALLOC_BINNED_POOL_SIZE);
+	static constexpr uint32 pageMapLeafBits	= MALLOC_BINNED_ADDRESS_BITS - poolShift - MALLOC_BINNED_PAGE_MAP_ROOT_BITS;
+	static constexpr uint64 pageMapRootSize	= 1ULL << MALLOC_BINNED_PAGE_MAP_ROOT_BITS;
+	static constexpr uint64 pageMapLeafSize	= 1ULL << pageMapLeafBits;
+	/// @}
+
+	/// Pool size must be a power of two, pool
+	/// buffers are aligned to their own size
+	static_assert((MALLOC_BINNED_POOL_SIZE & (MALLOC_BINNED_POOL_SIZE - 1)) == 0, "Pool size must be a power of two");
+
+	/// A leaf of the page map, maps pool slots to pools
+	using PageMapLeaf = MallocPool*[pageMapLeafSize];
+
+public:
+	/// Occupancy snapshot of a bucket
+	struct BucketStats
+	{
+		/// Block size of the bucket
+		sizet blockSize;
+
+		/// Number of pools
+		uint64 numPools;
+
+		/// Number of blocks in all pools
+		uint64 numBlocks;
+
+		/// Number of free blocks in pools, including never used blocks
+		uint64 numFreeBlocks;
+
+		/// Number of free blocks held by thread caches
+		uint64 numCachedBlocks;
+
+		/// Returns number of blocks in use
+		FORCE_INLINE uint64 getNumUsedBlocks() const { return numBlocks - numFreeBlocks - numCachedBlocks; }
+
+		/// Returns ratio of blocks in use
+		FORCE_INLINE float32 getOccupancy() const { return numBlocks ? float32(getNumUsedBlocks()) / numBlocks : 0.f; }
+	};
+
 protected:
-	/// Buckets of pools
-	PoolLinkRef buckets[MALLOC_BINNED_NUM_BUCKETS];
+	/// A per-thread cache of free blocks
+	struct ThreadCache
+	{
+		/// A bin of free blocks, linked
+		/// through the blocks themselves
+		struct Bin
+		{
+			/// Head of the list
+			void * head;
+
+			/// Number of blocks in bin, only written by
+			/// the owner thread, read by stats
+			uint32 count;
+
+			/// Sets count, relaxed atomic since stats
+			/// read it from other threads
+			FORCE_INLINE void setCount(uint32 n) { PlatformAtomics::storeRelaxed(&count, n); }
+		};
+		
+		/// A bin for each bucket
+		Bin bins[MALLOC_BINNED_NUM_BUCKETS];
+
+		/// Allocator that owns this cache
+		MallocBinned * owner;
+
+		/// NUMA node of the thread
+		uint32 node;
+
+		/// Next cache of the owner
+		ThreadCache * next;
+	};
+
+protected:
+	/// Buckets of pools, for each node
+	PoolLinkRef buckets[MALLOC_BINNED_MAX_NODES][MALLOC_BINNED_NUM_BUCKETS];
+
+	/// Max number of blocks cached per thread, per bucket
+	uint32 cacheLimits[MALLOC_BINNED_NUM_BUCKETS];
+
+	/// Buckets locks, for each node
+	CriticalSection bucketsCS[MALLOC_BINNED_MAX_NODES][MALLOC_BINNED_NUM_BUCKETS];
+
+	/// Number of nodes in use
+	uint32 numNodes;
+
+	/// Returns NUMA node of the calling thread
+	uint32 (*getNode)();
+
+	/// Two-level page map, pool slot -> pool
+	/// Allows for fast deallocation (O(1) search)
+	PageMapLeaf * pageMap[pageMapRootSize];
 
 	/// Tree of pool refs organized by memory address
-	/// Allows for fast deallocation (O(log(N)) search)
+	/// Fallback for pools not registered in the page map
 	PoolNodeRef root;
 
+	/// Lock for pool creation, page map and caches list
+	CriticalSection poolsCS;
+
+	/// TLS slot of the thread caches
+	uint32 cacheSlot;
+
+	/// List of thread caches
+	ThreadCache * caches;
+
+	/// Allocator used for large blocks
+	/// @{
+	Malloc * backupMalloc;
+	MallocMapped mappedMalloc;
+	/// @}
+
+	/// Max number of free pools per bucket
+	/// and node that trim keeps mapped
+	uint32 numRetainedPools;
+
 	/// Some stats
 	/// @{
 	uint64 numPools;
+	uint64 numUnmappedPools;
 	/// @}
 
 public:
-	/// Default constructor
-	MallocBinned();
+	/**
+	 * Default constructor
+	 * 
+	 * @param [in] _backupMalloc allocator used for large
+	 * 	blocks, if null a MallocMapped is used. It cannot be
+	 * 	the global allocator if this is the global allocator
+	 */
+	MallocBinned(Malloc * _backupMalloc = nullptr);
 
 	/// Default destructor
 	FORCE_INLINE ~MallocBinned()
 	{
-		// Destroy pools
-		for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+		// Destroy caches, blocks are owned by pools
+		PlatformTLS::clear(cacheSlot);
+
+		ThreadCache * next = caches, * it;
+		while ((it = next))
 		{
-			PoolLinkRef next = buckets[i], it;
-			while (it = next)
+			next = it->next;
+			::free(it);
+		}
+
+		// Destroy pools
+		for (uint32 k = 0; k < MALLOC_BINNED_MAX_NODES; ++k)
+			for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
 			{
-				next = it->next;
-				// Free whole block
-				::free(it);
+				PoolLinkRef next = buckets[k][i], it;
+				while ((it = next))
+				{
+					next = it->next;
+					// Free pool buffer and header
+					PlatformMemory::unmap(it->data.pool, MALLOC_BINNED_POOL_SIZE);
+					::free(it);
+				}
 			}
-		}
+
+		// Destroy page map
+		for (uint64 i = 0; i < pageMapRootSize; ++i)
+			::free(pageMap[i]);
 	}
 
 	/// Returns number of allocated pools
 	FORCE_INLINE uint64 getNumPools() { return numPools; }
 
-protected:
+	/**
+	 * Takes a snapshot of the occupancy of all buckets
+	 * Blocks freed remotely are reclaimed by the pools.
+	 * Cached blocks are counted while their threads
+	 * keep running, thus they are approximate
+	 * 
+	 * @param [out] stats stats of each bucket
+	 */
+	void getBucketStats(BucketStats (&stats)[MALLOC_BINNED_NUM_BUCKETS]);
+
+	/// Sets max number of free pools per bucket that trim keeps mapped
+	FORCE_INLINE void setNumRetainedPools(uint32 n) { numRetainedPools = n; }
+
+	/// Returns number of NUMA nodes with their own pools
+	FORCE_INLINE uint32 getNumNodes() const { return numNodes; }
+
+	/**
+	 * Overrides the NUMA topology, e.g. to test a
+	 * multi-node setup on a single node. Must be
+	 * called before any thread allocates, the node
+	 * of a thread is detected once
+	 * 
+	 * @param [in] _numNodes number of nodes, 1 disables
+	 * 	NUMA awareness
+	 * @param [in] _getNode returns node of the calling
+	 * 	thread, if null the node of its cpu is used
+	 */
+	void setTopology(uint32 _numNodes, uint32 (*_getNode)() = nullptr);
+
 	/// Get bucket index from required size
-	FORCE_INLINE uint32 getBucketIndex(sizet n) const
+	static FORCE_INLINE uint32 getBucketIndex(sizet n)
 	{
-		uint32 i = 0; while (n > MALLOC_BINNED_BLOCK_MIN_SIZE) ++i, n >>= 1;
+		// Linear up to 32 B, in steps of 8 B
+		if (n <= 32) return (n - (n != 0)) >> 3;
+
+		// Then four steps per power of two
+		const uint32 log2 = 63 - PlatformMath::getLeadingZeros(n - 1);
+		return ((log2 - 4) << 2) + ((n - 1) >> (log2 - 2)) - 4;
+	}
+
+	/// Get bucket index from required size and alignment
+	static FORCE_INLINE uint32 getBucketIndex(sizet n, uint32 alignment)
+	{
+		// At most three steps, the last class
+		// of each power of two is a power of two
+		uint32 i = getBucketIndex(PlatformMath::alignUp(n, alignment));
+		while (getBucketBlockSize(i) & (alignment - 1)) ++i;
 		return i;
 	}
 
+	/// Returns block size of the bucket
+	static FORCE_INLINE sizet getBucketBlockSize(uint32 bucketIdx)
+	{
+		if (bucketIdx < 4) return (bucketIdx + 1) << 3;
+
+		const uint32 log2 = (bucketIdx >> 2) + 4;
+		return sizet((bucketIdx & 3) + 5) << (log2 - 2);
+	}
+
+protected:
+	/// Returns page map slot of address
+	static FORCE_INLINE uint64 getPoolSlot(const void * address)
+	{
+		return reinterpret_cast<uintP>(address) >> poolShift;
+	}
+
+	/// Register pool in the page map, returns false if not possible
+	FORCE_INLINE bool mapPool(MallocPool * pool)
+	{
+		const uint64 slot = getPoolSlot(pool->pool);
+		const uint64 rootIdx = slot >> pageMapLeafBits;
+		if (UNLIKELY(rootIdx >= pageMapRootSize)) return false;
+
+		// Create leaf on first use
+		PageMapLeaf * leaf = pageMap[rootIdx];
+		if (UNLIKELY(leaf == nullptr))
+		{
+			if ((leaf = reinterpret_cast<PageMapLeaf*>(::calloc(1, sizeof(PageMapLeaf)))) == nullptr) return false;
+			PlatformAtomics::store(&pageMap[rootIdx], leaf);
+		}
+
+		// Publish pool, lookups are lock-free
+		PlatformAtomics::store(&(*leaf)[slot & (pageMapLeafSize - 1)], pool);
+		return true;
+	}
+
+	/// Find pool using page map
+	FORCE_INLINE MallocPool * findPoolInMap(const void * address) const
+	{
+		const uint64 slot = getPoolSlot(address);
+		const uint64 rootIdx = slot >> pageMapLeafBits;
+		if (UNLIKELY(rootIdx >= pageMapRootSize)) return nullptr;
+
+		const PageMapLeaf * leaf = PlatformAtomics::read(&pageMap[rootIdx]);
+		return leaf ? PlatformAtomics::read(&(*leaf)[slot & (pageMapLeafSize - 1)]) : nullptr;
+	}
+
+	/// Remove pool from the page map, returns false if not there
+	FORCE_INLINE bool unmapPool(MallocPool * pool)
+	{
+		if (findPoolInMap(pool->pool) != pool) return false;
+
+		const uint64 slot = getPoolSlot(pool->pool);
+		PageMapLeaf * leaf = pageMap[slot >> pageMapLeafBits];
+		PlatformAtomics::store(&(*leaf)[slot & (pageMapLeafSize - 1)], (MallocPool*)nullptr);
+		return true;
+	}
+
+	/// Find pool using tree, slow path
+	MallocPool * findPoolInTree(void * address);
+
+	/// Find pool that alloc'd address
+	FORCE_INLINE MallocPool * findPool(void * address)
+	{
+		MallocPool * pool = findPoolInMap(address);
+		if (LIKELY(pool != nullptr) | LIKELY(numUnmappedPools == 0))
+			return pool;
+		
+		// Fall back to tree
+		return findPoolInTree(address);
+	}
+
 	/// Create a new pool
 	/// Forced inline, not used outside class
-	FORCE_INLINE MallocPool * createPool(uint32 bucketIdx)
+	FORCE_INLINE MallocPool * createPool(uint32 bucketIdx, uint32 nodeIdx)
 	{
-		/// Update stats
-		++numPools;
+		// Page map and tree are shared by all buckets
+		ScopeLock poolsLock(&poolsCS);
 
 		/**
-		 * Create a new pool.
-		 *  PoolLink PoolNode Padding Pool buffer
-		 * |--------|--------|-------|-----------|
+		 * Create a new pool. The pool buffer is
+		 * aligned to its own size, the header is
+		 * allocated separately.
+		 *  PoolLink PoolNode     Pool buffer
+		 * |--------|--------|   |-----------|
 		 */
-		const sizet allocSize
+		const sizet headerSize
 			= sizeof(PoolLink)
-			+ sizeof(PoolNode)
-			+ MALLOC_BINNED_POOL_ALIGNMENT
-			+ MALLOC_BINNED_POOL_SIZE;
+			+ sizeof(PoolNode);
 
-		// Create buffer
-		void * buffer;
-		if (::posix_memalign(&buffer, PlatformMath::max(alignof(PoolLink), alignof(PoolNode)), allocSize) == 0)
+		// Create buffers
+		void * header, * poolBuffer;
+		if ((poolBuffer = PlatformMemory::map(MALLOC_BINNED_POOL_SIZE, MALLOC_BINNED_POOL_SIZE, MALLOC_BINNED_POOL_HUGE_PAGES)) == nullptr)
+			return nullptr;
+
+	#if MALLOC_BINNED_NUMA_BIND
+		// Pages are not touched yet
+		if (numNodes > 1) PlatformMemory::bindToNode(poolBuffer, MALLOC_BINNED_POOL_SIZE, nodeIdx);
+	#endif
+		
+		if (::posix_memalign(&header, PlatformMath::max(alignof(PoolLink), alignof(PoolNode)), headerSize) != 0)
 		{
-			// Compute offsets
-			PoolLinkRef link	= reinterpret_cast<PoolLinkRef>(buffer);
-			PoolNodeRef node	= reinterpret_cast<PoolNodeRef>(link + 1);
-			void * poolBuffer	= reinterpret_cast<void*>(PlatformMath::alignUp(reinterpret_cast<uint64>(node + 1), (uint64)MALLOC_BINNED_POOL_ALIGNMENT));
-			
-			// Compute pool properties
-			const sizet blockSize	= (1 << bucketIdx) * MALLOC_BINNED_BLOCK_MIN_SIZE;
-			const sizet chunkSize	= PlatformMath::alignUp(sizeof(void*) + blockSize, MALLOC_BINNED_BLOCK_ALIGNMENT);
-			const uint64 numBlocks	= (MALLOC_BINNED_POOL_SIZE - MALLOC_BINNED_BLOCK_ALIGNMENT) / chunkSize;
-
-			// Construct link
-			new (link) PoolLink((MallocPool&&)MallocPool(numBlocks, blockSize, MALLOC_BINNED_BLOCK_ALIGNMENT, poolBuffer));
-
-			// Construct node
-			new (node) PoolNode(Pair<void*, MallocPool*>(poolBuffer, &(link->data)));
-
-			// Link pool
-			link->linkNext(buckets[bucketIdx]);
-			buckets[bucketIdx] = link;
-
-			// Insert in tree
-			if (UNLIKELY(root == nullptr))
-			{
-				root = node;
-				root->color = PoolNode::NodeColor::BLACK;
-			}
-			else
-			{
-				root->insertUnique(node);
+			PlatformMemory::unmap(poolBuffer, MALLOC_BINNED_POOL_SIZE);
+			return nullptr;
+		}
 
-				if (UNLIKELY(root->parent))
-					root = root->parent;
-			}
+		/// Update stats
+		++numPools;
+
+		// Compute offsets
+		PoolLinkRef link	= reinterpret_cast<PoolLinkRef>(header);
+		PoolNodeRef node	= reinterpret_cast<PoolNodeRef>(link + 1);
+		
+		// Compute pool properties
+		const sizet blockSize	= getBucketBlockSize(bucketIdx);
+		const uint64 numBlocks	= MALLOC_BINNED_POOL_SIZE / blockSize;
+
+		// Construct link
+		new (link) PoolLink((MallocPool&&)MallocPool(numBlocks, blockSize, MALLOC_BINNED_BLOCK_ALIGNMENT, poolBuffer));
+
+		// Link pool
+		link->linkNext(buckets[nodeIdx][bucketIdx]);
+		buckets[nodeIdx][bucketIdx] = link;
 
-			return node->data.second;
+		// Register in page map
+		if (LIKELY(mapPool(&link->data)))
+			return &link->data;
+
+		// Construct node
+		new (node) PoolNode(Pair<void*, MallocPool*>(poolBuffer, &(link->data)));
+		++numUnmappedPools;
+
+		// Insert in tree
+		if (UNLIKELY(root == nullptr))
+		{
+			root = node;
+			root->color = PoolNode::NodeColor::BLACK;
+		}
+		else
+		{
+			root->insertUnique(node);
+
+			if (UNLIKELY(root->parent))
+				root = root->parent;
 		}
 
-		return nullptr;
+		return node->data.second;
 	}
 
+	/**
+	 * Returns a pool of the bucket with free blocks,
+	 * creates it if necessary. The pool is moved to
+	 * the front of the bucket.
+	 * Bucket lock must be held by caller
+	 * 
+	 * @param [in] bucketIdx bucket index
+	 * @param [in] nodeIdx node of the pools
+	 * @return pool or null if out of memory
+	 */
+	FORCE_INLINE MallocPool * findFreePool(uint32 bucketIdx, uint32 nodeIdx)
+	{
+		// Try first pool
+		PoolLinkRef head = buckets[nodeIdx][bucketIdx];
+		if (LIKELY(head != nullptr) && head->data.hasFreeBlocks())
+			return &head->data;
+
+		// Find next free pool
+		PoolLinkRef it = head ? head->next : nullptr;
+		while (it && !it->data.hasFreeBlocks()) it = it->next;
+
+		if (it)
+		{
+			// Bring forth
+			it->unlink();
+			it->linkNext(head);
+			buckets[nodeIdx][bucketIdx] = it;
+
+			return &it->data;
+		}
+
+		return createPool(bucketIdx, nodeIdx);
+	}
+
+	/**
+	 * Allocate a block from the bucket pools
+	 * Bucket lock must be held by caller
+	 * 
+	 * @param [in] bucketIdx bucket index
+	 * @param [in] nodeIdx node of the pools
+	 * @return allocated block or null
+	 */
+	FORCE_INLINE void * allocateFromBucket(uint32 bucketIdx, uint32 nodeIdx)
+	{
+		MallocPool * pool = findFreePool(bucketIdx, nodeIdx);
+		return pool ? pool->malloc(getBucketBlockSize(bucketIdx)) : nullptr;
+	}
+
+	/// Returns cache of the calling thread, creates it if necessary
+	FORCE_INLINE ThreadCache * getCache()
+	{
+		ThreadCache * cache = reinterpret_cast<ThreadCache*>(PlatformTLS::getValue(cacheSlot));
+		return LIKELY(cache != nullptr) ? cache : createCache();
+	}
+
+	/// Creates cache of the calling thread
+	ThreadCache * createCache();
+
+	/// Returns node of the calling thread
+	FORCE_INLINE uint32 getThreadNode()
+	{
+		if (LIKELY(numNodes == 1)) return 0;
+
+		ThreadCache * cache = getCache();
+		return cache ? cache->node : 0;
+	}
+
+	/// Returns true if request is served by the backup allocator
+	static FORCE_INLINE bool isBackupRequest(sizet n, uint32 alignment)
+	{
+		return n > MALLOC_BINNED_BLOCK_MAX_SIZE || UNLIKELY(alignment > MALLOC_BINNED_BLOCK_ALIGNMENT && PlatformMath::alignUp(n, alignment) > MALLOC_BINNED_BLOCK_MAX_SIZE);
+	}
+
+	/// Pushes a freed block in a cache bin, flushes half of the bin if full
+	FORCE_INLINE void pushToBin(ThreadCache::Bin & bin, void * original, uint32 cacheLimit)
+	{
+		*reinterpret_cast<void**>(original) = bin.head;
+		bin.head = original;
+
+		bin.setCount(bin.count + 1);
+		if (UNLIKELY(bin.count > cacheLimit))
+			flushBin(bin, bin.count / 2);
+	}
+
+	/// Flushes cache on thread exit
+	static void destroyCache(void * cache);
+
+	/// Moves a batch of blocks from bucket pools to a cache bin
+	/// @return false if out of memory
+	bool refillBin(ThreadCache::Bin & bin, uint32 bucketIdx, uint32 nodeIdx);
+
+	/// Moves n blocks from a cache bin back to the bucket pools
+	void flushBin(ThreadCache::Bin & bin, uint32 n);
+
+	/**
+	 * Release a fully free pool and its buffer
+	 * Bucket lock must be held by caller
+	 * 
+	 * @param [in] link pool link
+	 * @param [in] bucketIdx bucket of the pool
+	 * @param [in] nodeIdx node of the pool
+	 * @return false if pool cannot be released
+	 */
+	bool releasePool(PoolLinkRef link, uint32 bucketIdx, uint32 nodeIdx);
+
 public:
 	//////////////////////////////////////////////////
 	// Malloc interface
@@ -173,7 +597,35 @@ public:
 	/// @copydoc Malloc::free()
 	virtual void free(void * original) override;
 
+	/// Large blocks skip the pool lookup. Small
+	/// blocks still use the page map, since the
+	/// size may not match the block size class
+	virtual void freeSized(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// Empties the cache bin first, then takes
+	/// runs of free blocks from the bucket pools
+	virtual uint32 mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// Blocks of the same pool are given back
+	/// as a single chain, without locking
+	virtual void freeBatch(void ** originals, uint32 count) override;
+
 	/// @copydoc Malloc::getAllocSize()
 	virtual bool getAllocSize(void * original, sizet & n) override;
+
+	/**
+	 * Flushes the cache of the calling thread and
+	 * gives back fully free pools to the OS. Blocks
+	 * cached by other threads are not reclaimed
+	 */
+	virtual void trim() override;
+
+	/**
+	 * Writes bucket stats and an occupancy bitmap of
+	 * each pool. Digit i of a bitmap is 1 if the i-th
+	 * slot of MALLOC_BINNED_OCCUPANCY_SLOT_SIZE Bytes
+	 * of the pool holds a block in use or cached
+	 */
+	virtual bool writeStats(FILE * out) override;
 };
 
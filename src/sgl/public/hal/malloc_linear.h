@@ -0,0 +1,137 @@
+#pragma once
+
+#include "core_types.h"
+#include "platform_memory.h"
+
+#define MALLOC_LINEAR_NUM_FRAMES 3	// Default number of frame buffers
+
+/// @brief Global per-frame allocator
+extern class MallocLinear * gFrameMalloc;
+
+/**
+ * @class MallocLinear hal/malloc_linear.h
+ * 
+ * A linear (arena) allocator for short-lived data.
+ * Blocks are carved from a buffer with a bump
+ * pointer, free does nothing and the whole buffer
+ * is reset at once.
+ * 
+ * The allocator cycles through N buffers, one per
+ * frame: @ref nextFrame() moves to the next buffer
+ * and resets it, so that a block stays valid for N
+ * frames (e.g. while the render thread consumes it).
+ * 
+ * When a frame buffer is full, blocks are allocated
+ * with the overflow allocator and freed when that
+ * frame buffer is reset.
+ * 
+ * The allocator is not thread-safe
+ */
+class MallocLinear : public Malloc
+{
+protected:
+	/// Header of an overflow block
+	struct GCC_ALIGN(16) OverflowHeader
+	{
+		/// Next overflow block of the frame
+		OverflowHeader * next;
+
+		/// Buffer returned by overflow allocator
+		void * buffer;
+
+		/// Size of the block in Bytes
+		sizet size;
+	};
+
+	/// A frame buffer
+	struct Frame
+	{
+		/// Buffer base address
+		void * buffer;
+
+		/// First free Byte
+		void * curr;
+
+		/// Overflow blocks of this frame
+		OverflowHeader * overflow;
+	};
+
+	/// Frame buffers
+	Frame * frames;
+
+	/// Number of frame buffers
+	uint32 numFrames;
+
+	/// Index of current frame buffer
+	uint32 frameIdx;
+
+	/// Size of a frame buffer in Bytes
+	sizet frameSize;
+
+	/// Allocator used when a frame buffer is full
+	Malloc * overflowMalloc;
+
+	/// Last allocated block, can be resized in place
+	void * last;
+
+protected:
+	/// Returns end address of frame buffer
+	FORCE_INLINE void * getFrameEnd(const Frame & frame) const
+	{
+		return reinterpret_cast<void*>(reinterpret_cast<uintP>(frame.buffer) + frameSize);
+	}
+
+	/// Returns frame buffer that contains block, if any
+	FORCE_INLINE Frame * findFrame(void * original) const
+	{
+		for (uint32 i = 0; i < numFrames; ++i)
+			if (original >= frames[i].buffer && original < getFrameEnd(frames[i]))
+				return &frames[i];
+		
+		return nullptr;
+	}
+
+	/// Allocates an overflow block for the current frame
+	void * mallocOverflow(sizet n, uint32 alignment);
+
+	/// Frees all overflow blocks of a frame
+	void freeOverflow(Frame & frame);
+
+public:
+	/**
+	 * Default constructor
+	 * 
+	 * @param [in] _frameSize size of a frame buffer in Bytes
+	 * @param [in] _numFrames number of frame buffers
+	 * @param [in] _overflowMalloc allocator used when a frame
+	 * 	buffer is full, if null gMalloc is used
+	 */
+	MallocLinear(sizet _frameSize, uint32 _numFrames = MALLOC_LINEAR_NUM_FRAMES, Malloc * _overflowMalloc = nullptr);
+
+	/// Destructor
+	~MallocLinear();
+
+	/// Moves to the next frame buffer and resets it
+	/// Blocks allocated N frames ago become invalid
+	void nextFrame();
+
+	/// Returns number of Bytes used in current frame buffer
+	FORCE_INLINE sizet getFrameUsage() const
+	{
+		return reinterpret_cast<uintP>(frames[frameIdx].curr) - reinterpret_cast<uintP>(frames[frameIdx].buffer);
+	}
+
+	//////////////////////////////////////////////////
+	// Malloc interface
+	//////////////////////////////////////////////////
+
+	/// @copydoc Malloc::malloc()
+	virtual void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::realloc()
+	virtual void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// Only rolls back the last block, memory
+	/// is reclaimed by @ref nextFrame()
+	virtual void free(void * original) override;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "core_types.h"
+#include "platform_memory.h"
+
+/**
+ * @class MallocMapped hal/malloc_mapped.h
+ * 
+ * Allocator for large blocks. Each block is
+ * mapped directly from the OS and unmapped when
+ * freed, a small header right before the block
+ * records the mapping.
+ * 
+ * Blocks can be backed by huge pages, which
+ * greatly reduces TLB misses on large buffers.
+ * Reallocation resizes the mapping in place or
+ * moves it without copying, when possible.
+ */
+class MallocMapped : public Malloc
+{
+protected:
+	/// Block header
+	struct Header
+	{
+		/// Base address of the mapping
+		void * base;
+
+		/// Size of the mapping in Bytes
+		sizet size;
+	};
+
+	/// If true, ask for huge pages
+	bool bHugePages;
+
+protected:
+	/// Returns header of block
+	static FORCE_INLINE Header * getHeader(void * original)
+	{
+		return reinterpret_cast<Header*>(original) - 1;
+	}
+
+public:
+	/// Default constructor
+	FORCE_INLINE MallocMapped(bool _bHugePages = true) :
+		bHugePages(_bHugePages) {}
+
+	//////////////////////////////////////////////////
+	// Malloc interface
+	//////////////////////////////////////////////////
+
+	/// @copydoc Malloc::malloc()
+	virtual void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::realloc()
+	virtual void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::free()
+	virtual void free(void * original) override;
+
+	/// @copydoc Malloc::getAllocSize()
+	virtual bool getAllocSize(void * original, sizet & n) override;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "core_types.h"
+#include "platform_memory.h"
+#include <new>
+
+/**
+ * @struct HeapAllocator hal/malloc_policy.h
+ * 
+ * Allocator policies tell containers where their
+ * memory comes from at compile time. A policy has
+ * the same methods as @ref Malloc, but no virtual
+ * interface, and tells if a block is stored inside
+ * the policy itself. Containers derive from their
+ * policy, so that stateless policies take no space.
+ * 
+ * The heap allocator is the default policy. It is
+ * stateless and forwards to gMalloc, which is
+ * created on first use if necessary
+ */
+struct HeapAllocator
+{
+	/// Returns global allocator
+	static FORCE_INLINE Malloc * get()
+	{
+		if (UNLIKELY(gMalloc == nullptr)) Memory::createGMalloc();
+		return gMalloc;
+	}
+
+	/// Malloc interface
+	/// @{
+	FORCE_INLINE void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) { return get()->malloc(n, alignment); }
+	FORCE_INLINE void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) { return get()->realloc(original, n, alignment); }
+	FORCE_INLINE void free(void * original) { get()->free(original); }
+	FORCE_INLINE uint32 mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment = DEFAULT_ALIGNMENT) { return get()->mallocBatch(n, count, out, alignment); }
+	FORCE_INLINE void freeBatch(void ** originals, uint32 count) { get()->freeBatch(originals, count); }
+	FORCE_INLINE bool getAllocSize(void * original, sizet & n) { return get()->getAllocSize(original, n); }
+	/// @}
+
+	/// Blocks are never stored in the policy
+	FORCE_INLINE constexpr bool isInline(const void * block) const { return false; }
+};
+
+/**
+ * @struct StaticAllocator hal/malloc_policy.h
+ * 
+ * A stateless policy that allocates with a single
+ * instance of MallocT shared by all containers.
+ * Calls are not virtual, so they can be inlined:
+ * 
+ * ```
+ * Array<Particle, StaticAllocator<MallocTLSF>> particles;
+ * ```
+ */
+template<typename MallocT>
+struct StaticAllocator
+{
+	/// Returns shared instance, created on first use
+	static FORCE_INLINE MallocT * get()
+	{
+		// Never destroyed, containers may outlive static destructors
+		alignas(MallocT) static uint8 storage[sizeof(MallocT)];
+		static MallocT * const instance = new (storage) MallocT;
+		return instance;
+	}
+
+	/// Malloc interface
+	/// @{
+	FORCE_INLINE void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) { return get()->MallocT::malloc(n, alignment); }
+	FORCE_INLINE void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) { return get()->MallocT::realloc(original, n, alignment); }
+	FORCE_INLINE void free(void * original) { get()->MallocT::free(original); }
+	FORCE_INLINE uint32 mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment = DEFAULT_ALIGNMENT) { return get()->MallocT::mallocBatch(n, count, out, alignment); }
+	FORCE_INLINE void freeBatch(void ** originals, uint32 count) { get()->MallocT::freeBatch(originals, count); }
+	FORCE_INLINE bool getAllocSize(void * original, sizet & n) { return get()->MallocT::getAllocSize(original, n); }
+	/// @}
+
+	/// Blocks are never stored in the policy
+	FORCE_INLINE constexpr bool isInline(const void * block) const { return false; }
+};
+
+/**
+ * @struct PointerAllocator hal/malloc_policy.h
+ * 
+ * A stateful policy that allocates with a given
+ * instance of MallocT, for containers that must
+ * use a specific pool or arena:
+ * 
+ * ```
+ * TypedPool<Link<int32>> links;
+ * LinkedList<int32, PointerAllocator<TypedPool<Link<int32>>>> list(&links);
+ * ```
+ * 
+ * If no instance is given, the instance of
+ * StaticAllocator<MallocT> is used
+ */
+template<typename MallocT>
+struct PointerAllocator
+{
+	/// Allocator in use
+	MallocT * allocator;
+
+	/// Default constructor
+	FORCE_INLINE PointerAllocator(MallocT * _allocator = StaticAllocator<MallocT>::get()) :
+		allocator(_allocator) {}
+
+	/// Malloc interface
+	/// @{
+	FORCE_INLINE void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) { return allocator->malloc(n, alignment); }
+	FORCE_INLINE void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) { return allocator->realloc(original, n, alignment); }
+	FORCE_INLINE void free(void * original) { allocator->free(original); }
+	FORCE_INLINE uint32 mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment = DEFAULT_ALIGNMENT) { return allocator->mallocBatch(n, count, out, alignment); }
+	FORCE_INLINE void freeBatch(void ** originals, uint32 count) { allocator->freeBatch(originals, count); }
+	FORCE_INLINE bool getAllocSize(void * original, sizet & n) { return allocator->getAllocSize(original, n); }
+	/// @}
+
+	/// Blocks are never stored in the policy
+	FORCE_INLINE constexpr bool isInline(const void * block) const { return false; }
+};
+
+/**
+ * @struct InlineAllocator hal/malloc_policy.h
+ * 
+ * A stateful policy that stores a block of up to
+ * numBytes Bytes inside itself, and spills larger
+ * blocks to the policy SecondaryT. Meant for
+ * containers with a single buffer that are usually
+ * small, see @ref InlineArray and @ref String.
+ * 
+ * Only one block at a time is stored inline. When
+ * an inline block grows past numBytes it moves to
+ * SecondaryT for good. Copies of the policy start
+ * with free inline storage, a container can't take
+ * an inline block from another one (see @ref
+ * isInline())
+ */
+template<sizet numBytes, sizet alignment = DEFAULT_ALIGNMENT, typename SecondaryT = HeapAllocator>
+struct InlineAllocator : public SecondaryT
+{
+protected:
+	/// Inline storage
+	alignas(alignment) uint8 storage[numBytes];
+
+	/// True if storage holds a block
+	bool bInlineUsed;
+
+	/// Returns true if request fits inline storage
+	static FORCE_INLINE constexpr bool fitsInline(sizet n, uint32 blockAlignment)
+	{
+		return n <= numBytes && blockAlignment <= alignment;
+	}
+
+public:
+	/// Default constructor
+	FORCE_INLINE InlineAllocator(const SecondaryT & secondary = SecondaryT()) :
+		SecondaryT(secondary),
+		bInlineUsed(false) {}
+
+	/// Copy constructor, storage is not copied
+	FORCE_INLINE InlineAllocator(const InlineAllocator & other) :
+		SecondaryT(other),
+		bInlineUsed(false) {}
+
+	/// Copy assignment, storage is not copied
+	FORCE_INLINE InlineAllocator & operator=(const InlineAllocator & other)
+	{
+		SecondaryT::operator=(other);
+		return *this;
+	}
+
+	/// Returns true if block is stored inline
+	FORCE_INLINE bool isInline(const void * block) const { return block == storage; }
+
+	/// Malloc interface
+	/// @{
+	FORCE_INLINE void * malloc(sizet n, uint32 blockAlignment = DEFAULT_ALIGNMENT)
+	{
+		if (fitsInline(n, blockAlignment) && !bInlineUsed)
+		{
+			bInlineUsed = true;
+			return storage;
+		}
+
+		return SecondaryT::malloc(n, blockAlignment);
+	}
+
+	FORCE_INLINE void * realloc(void * original, sizet n, uint32 blockAlignment = DEFAULT_ALIGNMENT)
+	{
+		if (original == nullptr) return malloc(n, blockAlignment);
+		if (!isInline(original)) return SecondaryT::realloc(original, n, blockAlignment);
+
+		if (n == 0)
+		{
+			bInlineUsed = false;
+			return nullptr;
+		}
+
+		if (fitsInline(n, blockAlignment)) return storage;
+
+		// Spill to secondary allocator
+		void * out = SecondaryT::malloc(n, blockAlignment);
+		if (out)
+		{
+			PlatformMemory::memcpy(out, storage, numBytes);
+			bInlineUsed = false;
+		}
+
+		return out;
+	}
+
+	FORCE_INLINE void free(void * original)
+	{
+		if (isInline(original)) bInlineUsed = false;
+		else SecondaryT::free(original);
+	}
+
+	FORCE_INLINE bool getAllocSize(void * original, sizet & n)
+	{
+		if (!isInline(original)) return SecondaryT::getAllocSize(original, n);
+
+		n = numBytes;
+		return true;
+	}
+	/// @}
+};
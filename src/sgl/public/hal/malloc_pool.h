@@ -3,21 +3,36 @@
 #include "core_types.h"
 #include "platform_memory.h"
 #include "platform_math.h"
+#include "platform_atomics.h"
 
 /**
  * @class MallocPool hal/malloc_pool.h
  * 
  * A fixed size pool with a fixed block size.
  * Blocks are managed by a singly linked list
- * embedded in the blocks themselves. Blocks
- * are introduced by a descriptor which points
- * to the next block in the free list.
+ * embedded in the free blocks themselves, thus
+ * blocks have no header and must be at least
+ * as large as a pointer.
  * 
  * When a block is freed it is reinserted at
  * the beginning of the list.
  * 
+ * The free list is initialized lazily: blocks
+ * that were never used are handed out by a bump
+ * pointer, and the free list only holds recycled
+ * blocks. Creating a pool doesn't touch its buffer.
+ * 
+ * The pool is not thread-safe, except for the
+ * remote free list: threads other than the owner
+ * can push blocks on it with @ref freeRemote()
+ * without locking. The owner drains it in a single
+ * batch when the free list runs empty.
+ * 
  * It is possible to specify the alignment of
  * the blocks, it should be a power of two.
+ * Blocks are aligned to the largest power of two
+ * that divides both the buffer address and the
+ * block size, requests for larger alignments fail.
  */
 class GCC_ALIGN(32) MallocPool : public Malloc
 {
@@ -34,9 +49,21 @@ protected:
 	/// Head of free list
 	void * head;
 
+	/// Head of remote free list (lock-free)
+	void * volatile remoteHead;
+
+	/// First never used block
+	void * bump;
+
+	/// Address past the last block
+	void * bumpEnd;
+
 	/// Size of a single block in Bytes
 	sizet blockSize;
 
+	/// Distance between two blocks in Bytes
+	sizet chunkSize;
+
 	/// Total number of blocks
 	uint64 numBlocks;
 
@@ -44,39 +71,25 @@ protected:
 	uint64 numFreeBlocks;
 
 protected:
-	/// Set descriptor value
-	FORCE_INLINE void * setNext(void * descriptor, void ** next)
-	{
-		return *reinterpret_cast<void**>(descriptor) = next;
-	}
-
-	/// Get discriptor value
-	FORCE_INLINE void * getNext(void * descriptor)
+	/// Set next free block
+	static FORCE_INLINE void * setNext(void * block, void * next)
 	{
-		return *reinterpret_cast<void**>(descriptor);
+		return *reinterpret_cast<void**>(block) = next;
 	}
 
-	/// Get block address from descriptor
-	FORCE_INLINE void * getBlock(void * descriptor)
+	/// Get next free block
+	static FORCE_INLINE void * getNext(void * block)
 	{
-		return reinterpret_cast<void*>(reinterpret_cast<uint64>(descriptor) + sizeof(void*));
+		return *reinterpret_cast<void**>(block);
 	}
 
-	/// Get descriptor address from block
-	FORCE_INLINE void * getDescriptor(void * block)
-	{
-		return reinterpret_cast<void*>(reinterpret_cast<uint64>(block) - sizeof(void*));
-	}
-
-	/// Set descriptor value to offset
-	FORCE_INLINE void * setOffset(void * descriptor, sizet offset)
-	{
-		return *reinterpret_cast<void**>(descriptor) = reinterpret_cast<void**>(reinterpret_cast<uint64>(descriptor) + offset);
-	}
+	/// Moves remote free list in free list
+	/// @return true if any block was moved
+	bool drainRemote();
 
 public:
 	/// Default constructor
-	MallocPool(uint64 _numBlocks = 65536, sizet _blockSize = 64/* Bytes */, sizet blockAlignment = 0x20, void * buffer = nullptr);
+	MallocPool(uint64 _numBlocks = 65536, sizet _blockSize = 64/* Bytes */, sizet blockAlignment = 0x8, void * buffer = nullptr);
 
 	/// @todo Make it non-copyable
 
@@ -84,14 +97,50 @@ public:
 	FORCE_INLINE ~MallocPool()
 	{
 		if (bHasOwnBuffer)
-			free(pool);
+			::free(pool);
 	}
 
 	/// Returns num of free blocks
+	/// Does not include remotely freed blocks
 	FORCE_INLINE uint64 getNumFreeBlock() const { return numFreeBlocks; }
 
+	/// Returns total num of blocks
+	FORCE_INLINE uint64 getNumBlocks() const { return numBlocks; }
+
+	/// Returns num of slots of given size that cover the pool
+	FORCE_INLINE uint64 getNumSlots(sizet slotSize) const
+	{
+		return (reinterpret_cast<uintP>(end) - reinterpret_cast<uintP>(pool) + slotSize - 1) / slotSize;
+	}
+
+	/**
+	 * Writes a bitmap of the slots of the pool that
+	 * hold at least a block in use. A block belongs
+	 * to the slot of its first Byte. Remotely freed
+	 * blocks count as used. Not thread-safe
+	 * 
+	 * @param [out] bitmap at least getNumSlots() bits, zeroed
+	 * @param [in] slotSize size of a slot in Bytes
+	 * @return false if out of memory
+	 */
+	bool getOccupancy(uint8 * bitmap, sizet slotSize) const;
+
+	/// Returns true if pool has free blocks, either local or remote
+	FORCE_INLINE bool hasFreeBlocks() const { return numFreeBlocks | (PlatformAtomics::readRelaxed(&remoteHead) != nullptr); }
+
+	/// Returns true if no block is in use
+	/// Does not include remotely freed blocks
+	FORCE_INLINE bool isUnused() const { return numFreeBlocks == numBlocks; }
+
+	/// Returns alignment guaranteed for all blocks
+	FORCE_INLINE sizet getBlockAlignment() const
+	{
+		const sizet address = reinterpret_cast<sizet>(pool);
+		return PlatformMath::min(chunkSize & -chunkSize, address & -address);
+	}
+
 	/// Returns true if block was allocated by this allocator
-	FORCE_INLINE bool hasBlock(void * original) const { return original > pool && original < end; }
+	FORCE_INLINE bool hasBlock(void * original) const { return original >= pool && original < end; }
 
 	//////////////////////////////////////////////////
 	// Malloc interface
@@ -108,4 +157,47 @@ public:
 
 	/// @copydoc Malloc::getAllocSize()
 	virtual bool getAllocSize(void * original, sizet & n) override;
+
+	/// @copydoc Malloc::mallocBatch()
+	virtual uint32 mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// Links blocks together and splices
+	/// the chain in the free list
+	virtual void freeBatch(void ** originals, uint32 count) override;
+
+	/**
+	 * If no block is in use, decommits the pages
+	 * touched so far and resets the pool to its
+	 * initial state. Not thread-safe
+	 */
+	virtual void trim() override;
+
+	/**
+	 * Free a block from a thread that doesn't own
+	 * the pool. The block is pushed on the remote
+	 * free list and reclaimed by the owner later
+	 * 
+	 * @param [in] original block to free
+	 */
+	FORCE_INLINE void freeRemote(void * original)
+	{
+		freeRemote(original, original);
+	}
+
+	/**
+	 * Push a chain of blocks on the remote free
+	 * list with a single atomic operation
+	 * 
+	 * @param [in] first,last first and last blocks of the chain
+	 */
+	FORCE_INLINE void freeRemote(void * first, void * last)
+	{
+		void * prev = PlatformAtomics::read(&remoteHead), * curr;
+		for (;;)
+		{
+			setNext(last, prev);
+			if ((curr = PlatformAtomics::compareExchange(&remoteHead, prev, first)) == prev) break;
+			prev = curr;
+		}
+	}
 };
\ No newline at end of file
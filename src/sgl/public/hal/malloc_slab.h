@@ -0,0 +1,399 @@
+#pragma once
+
+#include "core_types.h"
+#include "platform_memory.h"
+#include "platform_math.h"
+#include "platform_threads.h"
+#include "critical_section.h"
+
+#define MALLOC_SLAB_SIZE (64 * 1024)		// Size of a slab, 64 KB
+#define MALLOC_SLAB_BATCH_BLOCKS 32			// Number of blocks moved between a thread cache and the shared list
+#define MALLOC_SLAB_CACHE_MAX_BLOCKS 128	// Max number of blocks cached per thread
+
+/**
+ * @class TypedPool hal/malloc_slab.h
+ * 
+ * A slab allocator for objects of type T, meant
+ * for the nodes of node-based containers:
+ * 
+ * ```
+ * using Pool = TypedPool<BinaryNode<int32>>;
+ * Pool nodes;
+ * BinaryTree<int32, Compare, PointerAllocator<Pool>> tree(&nodes);
+ * ```
+ * 
+ * A container created without a pool uses a
+ * pool shared by all containers of its type.
+ * 
+ * Memory is mapped in slabs of fixed size, each
+ * cut in blocks of sizeof(T) Bytes aligned to
+ * alignof(T). Free blocks have no header, they
+ * are linked through the blocks themselves.
+ * 
+ * Each thread owns a cache of free blocks, so that
+ * allocations and deallocations don't lock. Blocks
+ * move between the caches and a shared free list in
+ * batches: an empty cache takes a batch from the
+ * shared list, or carves it from the current slab;
+ * a full cache gives a batch back. A block may be
+ * freed by any thread. If no TLS slot is left
+ * for the pool, all threads use the shared list.
+ * 
+ * Requests larger than sizeof(T) or more aligned
+ * than alignof(T) fail. Slabs are unmapped only
+ * when the pool is destroyed.
+ */
+template<typename T>
+class TypedPool : public Malloc
+{
+public:
+	/// Block layout constants
+	/// @{
+	static constexpr sizet blockAlignment	= PlatformMath::max(alignof(T), alignof(void*));
+	static constexpr sizet blockSize		= PlatformMath::alignUp(PlatformMath::max(sizeof(T), sizeof(void*)), blockAlignment);
+	/// @}
+
+	static_assert(blockAlignment <= 0x1000, "Slabs are only page aligned");
+
+protected:
+	/// Header of a slab, blocks follow it
+	struct Slab
+	{
+		/// Next slab
+		Slab * next;
+	};
+
+	/// Offset of the first block in a slab
+	static constexpr sizet slabHeaderSize = PlatformMath::alignUp(sizeof(Slab), blockAlignment);
+
+	/// A per-thread cache of free blocks
+	struct ThreadCache
+	{
+		/// Head of the list
+		void * head;
+
+		/// Number of blocks in cache
+		uint32 count;
+
+		/// Pool that owns this cache
+		TypedPool * owner;
+
+		/// Next cache of the owner
+		ThreadCache * next;
+	};
+
+protected:
+	/// Shared free list
+	/// @{
+	void * head;
+	uint32 count;
+	/// @}
+
+	/// Bump pointer of the current slab
+	/// @{
+	void * bump;
+	void * bumpEnd;
+	/// @}
+
+	/// Size of a slab in Bytes
+	sizet slabSize;
+
+	/// List of slabs
+	Slab * slabs;
+
+	/// TLS slot of the thread caches, invalid
+	/// if none was available
+	uint32 cacheSlot;
+
+	/// List of thread caches
+	ThreadCache * caches;
+
+	/// Lock for shared list, slabs and caches list
+	CriticalSection cs;
+
+	/// Some stats
+	uint64 numSlabs;
+
+protected:
+	/// Free list links, stored in the blocks
+	/// @{
+	static FORCE_INLINE void setNext(void * block, void * next) { *reinterpret_cast<void**>(block) = next; }
+	static FORCE_INLINE void * getNext(void * block) { return *reinterpret_cast<void**>(block); }
+	/// @}
+
+	/// Returns cache of the calling thread, creates it if necessary
+	/// Returns null if pool has no TLS slot
+	FORCE_INLINE ThreadCache * getCache()
+	{
+		if (UNLIKELY(!PlatformTLS::isValidSlot(cacheSlot))) return nullptr;
+
+		ThreadCache * cache = reinterpret_cast<ThreadCache*>(PlatformTLS::getValue(cacheSlot));
+		return LIKELY(cache != nullptr) ? cache : createCache();
+	}
+
+	/// Creates cache of the calling thread
+	ThreadCache * createCache()
+	{
+		// Don't allocate the cache with gMalloc, it may be destroyed first
+		ThreadCache * cache = reinterpret_cast<ThreadCache*>(::calloc(1, sizeof(ThreadCache)));
+		if (UNLIKELY(cache == nullptr)) return nullptr;
+
+		cache->owner = this;
+
+		{
+			// Link in caches list
+			ScopeLock lock(&cs);
+			cache->next = caches;
+			caches = cache;
+		}
+
+		PlatformTLS::setValue(cacheSlot, cache);
+		return cache;
+	}
+
+	/// Flushes cache on thread exit
+	static void destroyCache(void * _cache)
+	{
+		ThreadCache * cache = reinterpret_cast<ThreadCache*>(_cache);
+		TypedPool * owner = cache->owner;
+
+		// Give back all cached blocks
+		owner->flushCache(cache, cache->count);
+
+		{
+			// Unlink from caches list
+			ScopeLock lock(&owner->cs);
+
+			ThreadCache ** it = &owner->caches;
+			while (*it != cache) it = &(*it)->next;
+			*it = cache->next;
+		}
+
+		::free(cache);
+	}
+
+	/// Moves a batch of blocks from the shared list
+	/// or the current slab to a cache
+	/// @return false if out of memory
+	bool refillCache(ThreadCache * cache)
+	{
+		ScopeLock lock(&cs);
+
+		if (count)
+		{
+			// Detach first blocks of shared list
+			void * first = head, * last = head;
+			uint32 n = 1;
+			for (; n < MALLOC_SLAB_BATCH_BLOCKS && getNext(last); ++n) last = getNext(last);
+
+			head = getNext(last);
+			count -= n;
+
+			setNext(last, cache->head);
+			cache->head = first;
+			cache->count += n;
+
+			return true;
+		}
+
+		if (bump == bumpEnd && !createSlab()) return false;
+
+		// Carve a batch from the current slab
+		uintP block = reinterpret_cast<uintP>(bump);
+		uint32 n = PlatformMath::min<uintP>(MALLOC_SLAB_BATCH_BLOCKS, (reinterpret_cast<uintP>(bumpEnd) - block) / blockSize);
+		bump = reinterpret_cast<void*>(block + n * blockSize);
+
+		cache->count += n;
+		for (; n > 0; --n, block += blockSize)
+		{
+			setNext(reinterpret_cast<void*>(block), cache->head);
+			cache->head = reinterpret_cast<void*>(block);
+		}
+
+		return true;
+	}
+
+	/// Takes a single block from the shared list
+	/// or the current slab, used without cache
+	void * mallocShared()
+	{
+		ScopeLock lock(&cs);
+
+		if (void * out = head)
+		{
+			head = getNext(out);
+			--count;
+			return out;
+		}
+
+		if (bump == bumpEnd && !createSlab()) return nullptr;
+
+		void * out = bump;
+		bump = reinterpret_cast<void*>(reinterpret_cast<uintP>(bump) + blockSize);
+		return out;
+	}
+
+	/// Moves n blocks from a cache to the shared list
+	void flushCache(ThreadCache * cache, uint32 n)
+	{
+		if (n == 0) return;
+
+		// Detach first n blocks of cache
+		void * first = cache->head, * last = first;
+		for (uint32 i = 1; i < n; ++i) last = getNext(last);
+
+		cache->head = getNext(last);
+		cache->count -= n;
+
+		ScopeLock lock(&cs);
+
+		setNext(last, head);
+		head = first;
+		count += n;
+	}
+
+	/// Maps a new slab and resets the bump pointer
+	/// Lock must be held by caller
+	bool createSlab()
+	{
+		Slab * slab = reinterpret_cast<Slab*>(PlatformMemory::map(slabSize));
+		if (UNLIKELY(slab == nullptr)) return false;
+
+		slab->next = slabs;
+		slabs = slab;
+		++numSlabs;
+
+		bump = reinterpret_cast<void*>(reinterpret_cast<uintP>(slab) + slabHeaderSize);
+		bumpEnd = reinterpret_cast<void*>(reinterpret_cast<uintP>(slab) + slabHeaderSize + (slabSize - slabHeaderSize) / blockSize * blockSize);
+
+		return true;
+	}
+
+public:
+	/**
+	 * Default constructor, slabs are mapped on first use
+	 * 
+	 * @param [in] _slabSize size of a slab in Bytes, it
+	 * 	should hold at least a batch of blocks
+	 */
+	FORCE_INLINE TypedPool(sizet _slabSize = MALLOC_SLAB_SIZE) :
+		head(nullptr),
+		count(0),
+		bump(nullptr),
+		bumpEnd(nullptr),
+		slabSize(PlatformMath::alignUp(PlatformMath::max(_slabSize, slabHeaderSize + blockSize), PlatformMemory::getPageSize())),
+		slabs(nullptr),
+		cacheSlot(PlatformTLS::allocateSlot(&TypedPool::destroyCache)),
+		caches(nullptr),
+		numSlabs(0) {}
+
+	/// Destructor, unmaps all slabs
+	~TypedPool()
+	{
+		// Destroy caches, blocks are owned by slabs
+		if (PlatformTLS::isValidSlot(cacheSlot)) PlatformTLS::clear(cacheSlot);
+
+		ThreadCache * nextCache = caches, * cache;
+		while ((cache = nextCache))
+		{
+			nextCache = cache->next;
+			::free(cache);
+		}
+
+		Slab * nextSlab = slabs, * slab;
+		while ((slab = nextSlab))
+		{
+			nextSlab = slab->next;
+			PlatformMemory::unmap(slab, slabSize);
+		}
+	}
+
+	/// Returns number of mapped slabs
+	FORCE_INLINE uint64 getNumSlabs() const { return numSlabs; }
+
+	/// Returns number of blocks in a slab
+	FORCE_INLINE sizet getNumSlabBlocks() const { return (slabSize - slabHeaderSize) / blockSize; }
+
+	/// Typed interface
+	/// @{
+	FORCE_INLINE T * alloc() { return reinterpret_cast<T*>(malloc(blockSize)); }
+	FORCE_INLINE void release(T * object) { free(object); }
+	/// @}
+
+	//////////////////////////////////////////////////
+	// Malloc interface
+	//////////////////////////////////////////////////
+
+	/// @copydoc Malloc::malloc()
+	virtual void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override
+	{
+		if (UNLIKELY(n > blockSize || alignment > blockAlignment)) return nullptr;
+
+		ThreadCache * cache = getCache();
+		if (UNLIKELY(cache == nullptr)) return mallocShared();
+		if (UNLIKELY(cache->head == nullptr) && !refillCache(cache)) return nullptr;
+
+		// Pop from cache
+		void * out = cache->head;
+		cache->head = getNext(out);
+		--cache->count;
+
+		return out;
+	}
+
+	/// Blocks cannot grow, only returns
+	/// original if it's large enough
+	virtual void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override
+	{
+		if (original == nullptr) return malloc(n, alignment);
+		if (n == 0)
+		{
+			free(original);
+			return nullptr;
+		}
+
+		return n <= blockSize && (reinterpret_cast<uintP>(original) & (alignment - 1)) == 0 ? original : nullptr;
+	}
+
+	/// @copydoc Malloc::free()
+	virtual void free(void * original) override
+	{
+		if (UNLIKELY(original == nullptr)) return;
+
+		ThreadCache * cache = getCache();
+		if (UNLIKELY(cache == nullptr))
+		{
+			// Give block back directly
+			ScopeLock lock(&cs);
+			setNext(original, head);
+			head = original;
+			++count;
+			return;
+		}
+
+		// Push on cache
+		setNext(original, cache->head);
+		cache->head = original;
+
+		// Keep cache size bounded
+		if (++cache->count > MALLOC_SLAB_CACHE_MAX_BLOCKS) flushCache(cache, MALLOC_SLAB_BATCH_BLOCKS);
+	}
+
+	/// @copydoc Malloc::getAllocSize()
+	virtual bool getAllocSize(void * original, sizet & n) override
+	{
+		if (!original) return false;
+
+		n = blockSize;
+		return true;
+	}
+
+	/// Gives back blocks cached by the calling thread
+	virtual void trim() override
+	{
+		if (!PlatformTLS::isValidSlot(cacheSlot)) return;
+
+		if (ThreadCache * cache = reinterpret_cast<ThreadCache*>(PlatformTLS::getValue(cacheSlot)))
+			flushCache(cache, cache->count);
+	}
+};
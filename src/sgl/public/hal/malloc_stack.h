@@ -0,0 +1,157 @@
+#pragma once
+
+#include "core_types.h"
+#include "platform_memory.h"
+#include "platform_threads.h"
+
+#define MALLOC_STACK_THREAD_SIZE (1024 * 1024)	// Size of per-thread stacks, 1 MB
+
+/**
+ * @class MallocStack hal/malloc_stack.h
+ * 
+ * A LIFO allocator for scoped scratch memory.
+ * Blocks are carved from a buffer with a bump
+ * pointer. A marker saves the current position,
+ * popping it releases all blocks allocated since
+ * in constant time. Use @ref ScopedMarker to pop
+ * automatically at the end of a scope:
+ * 
+ * ```
+ * MallocStack::ScopedMarker marker;
+ * Array<uint32, PointerAllocator<MallocStack>> scratch(64, MallocStack::get());
+ * ```
+ * 
+ * When the buffer is full, blocks are allocated
+ * with the overflow allocator and freed when the
+ * enclosing marker is popped.
+ * 
+ * A stack is not thread-safe, @ref get() returns
+ * an instance owned by the calling thread
+ */
+class MallocStack : public Malloc
+{
+protected:
+	/// Header of an overflow block
+	struct GCC_ALIGN(16) OverflowHeader
+	{
+		/// Previous overflow block
+		OverflowHeader * prev;
+
+		/// Buffer returned by overflow allocator
+		void * buffer;
+
+		/// Size of the block in Bytes
+		sizet size;
+	};
+
+public:
+	/// A position in the stack
+	struct Marker
+	{
+		/// First free Byte
+		void * curr;
+
+		/// Last overflow block
+		OverflowHeader * overflow;
+	};
+
+	/// Pops to the marker pushed on construction
+	class ScopedMarker
+	{
+	protected:
+		/// Owning stack
+		MallocStack * stack;
+
+		/// Saved position
+		Marker marker;
+
+	public:
+		/// Default constructor, uses stack of calling thread
+		FORCE_INLINE ScopedMarker(MallocStack * _stack = MallocStack::get()) :
+			stack(_stack),
+			marker(_stack->pushMarker()) {}
+
+		/// Destructor
+		FORCE_INLINE ~ScopedMarker()
+		{
+			stack->popToMarker(marker);
+		}
+	};
+
+protected:
+	/// Stack buffer
+	void * buffer;
+
+	/// First free Byte
+	void * curr;
+
+	/// Buffer end address
+	void * end;
+
+	/// Last overflow block
+	OverflowHeader * overflow;
+
+	/// Allocator used when the buffer is full
+	Malloc * overflowMalloc;
+
+	/// Last allocated block, can be resized in place
+	void * last;
+
+protected:
+	/// Returns true if block lies in the buffer
+	FORCE_INLINE bool hasBlock(void * original) const
+	{
+		return original >= buffer && original < end;
+	}
+
+	/// Allocates an overflow block
+	void * mallocOverflow(sizet n, uint32 alignment);
+
+	/// Deletes stack on thread exit
+	static void destroyThreadStack(void * stack);
+
+public:
+	/**
+	 * Default constructor
+	 * 
+	 * @param [in] size size of the stack buffer in Bytes
+	 * @param [in] _overflowMalloc allocator used when the
+	 * 	buffer is full, if null gMalloc is used
+	 */
+	MallocStack(sizet size, Malloc * _overflowMalloc = nullptr);
+
+	/// Destructor
+	~MallocStack();
+
+	/// Returns stack of the calling thread, creates it if necessary
+	static MallocStack * get();
+
+	/// Returns current position
+	FORCE_INLINE Marker pushMarker() const
+	{
+		return Marker{curr, overflow};
+	}
+
+	/// Releases all blocks allocated after marker
+	void popToMarker(const Marker & marker);
+
+	/// Returns number of Bytes used in the buffer
+	FORCE_INLINE sizet getUsage() const
+	{
+		return reinterpret_cast<uintP>(curr) - reinterpret_cast<uintP>(buffer);
+	}
+
+	//////////////////////////////////////////////////
+	// Malloc interface
+	//////////////////////////////////////////////////
+
+	/// @copydoc Malloc::malloc()
+	virtual void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::realloc()
+	virtual void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// Only rolls back the last block, memory
+	/// is reclaimed by @ref popToMarker()
+	virtual void free(void * original) override;
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include "core_types.h"
+#include "platform_memory.h"
+#include "platform_math.h"
+#include "critical_section.h"
+
+#define MALLOC_TLSF_AREA_SIZE (64 * 1024 * 1024)	// Size of a memory area, 64 MB
+#define MALLOC_TLSF_SL_INDEX_COUNT_LOG2 5			// Log2 of number of second level lists
+
+/**
+ * @class MallocTLSF hal/malloc_tlsf.h
+ * 
+ * Two-Level Segregated Fit allocator, for code
+ * that needs a bounded allocation time.
+ * 
+ * Free blocks are kept in segregated lists: the
+ * first level splits sizes in powers of two, the
+ * second level splits each power of two linearly.
+ * Two levels of bitmaps track non-empty lists, so
+ * that a suitable block is found with two bit scans.
+ * Blocks are split on allocation and merged with
+ * their physical neighbours on free, both in O(1).
+ * 
+ * Blocks are carved from large memory areas. An
+ * area is mapped up front; when all areas are full
+ * a new one is mapped, which is the only operation
+ * that is not constant time.
+ * 
+ * The allocator is thread-safe, all operations run
+ * under a single lock
+ */
+class MallocTLSF : public Malloc
+{
+protected:
+	/// Index constants
+	/// @{
+	static constexpr uint32 alignSizeLog2		= 3;
+	static constexpr sizet alignSize			= sizet(1) << alignSizeLog2;
+	static constexpr uint32 slIndexCountLog2	= MALLOC_TLSF_SL_INDEX_COUNT_LOG2;
+	static constexpr uint32 slIndexCount		= 1U << slIndexCountLog2;
+	static constexpr uint32 flIndexMax			= 38;
+	static constexpr uint32 flIndexShift		= slIndexCountLog2 + alignSizeLog2;
+	static constexpr uint32 flIndexCount		= flIndexMax - flIndexShift + 1;
+	static constexpr sizet smallBlockSize		= sizet(1) << flIndexShift;
+	/// @}
+
+	static_assert(flIndexCount <= 64, "First level bitmap is 64 bits");
+	static_assert(slIndexCount <= 32, "Second level bitmaps are 32 bits");
+
+	/**
+	 * Block header. Only the size is always
+	 * valid: the previous block pointer is valid
+	 * only if the previous block is free, and
+	 * lives in its last Bytes; free list links
+	 * are valid only if the block is free, and
+	 * live in its payload
+	 */
+	struct BlockHeader
+	{
+		/// Previous physical block
+		BlockHeader * prevPhys;
+
+		/// Size of the block, two lowest bits are flags
+		sizet size;
+
+		/// Free list links
+		/// @{
+		BlockHeader * nextFree;
+		BlockHeader * prevFree;
+		/// @}
+
+		/// Flags stored in size
+		enum : sizet
+		{
+			FREE_BIT		= 0x1,
+			PREV_FREE_BIT	= 0x2
+		};
+
+		FORCE_INLINE sizet getSize() const { return size & ~sizet(FREE_BIT | PREV_FREE_BIT); }
+		FORCE_INLINE void setSize(sizet n) { size = n | (size & sizet(FREE_BIT | PREV_FREE_BIT)); }
+		FORCE_INLINE bool isLast() const { return getSize() == 0; }
+
+		FORCE_INLINE bool isFree() const { return size & FREE_BIT; }
+		FORCE_INLINE void setFree() { size |= FREE_BIT; }
+		FORCE_INLINE void setUsed() { size &= ~sizet(FREE_BIT); }
+
+		FORCE_INLINE bool isPrevFree() const { return size & PREV_FREE_BIT; }
+		FORCE_INLINE void setPrevFree() { size |= PREV_FREE_BIT; }
+		FORCE_INLINE void setPrevUsed() { size &= ~sizet(PREV_FREE_BIT); }
+	};
+
+	/// Block layout constants
+	/// @{
+	static constexpr sizet blockHeaderOverhead	= sizeof(sizet);
+	static constexpr sizet blockStartOffset		= sizeof(BlockHeader*) + sizeof(sizet);
+	static constexpr sizet blockSizeMin			= sizeof(BlockHeader) - sizeof(BlockHeader*);
+	static constexpr sizet blockSizeMax			= sizet(1) << flIndexMax;
+	/// @}
+
+	/// Header of a memory area
+	struct Area
+	{
+		/// Next area
+		Area * next;
+
+		/// Size of the area in Bytes
+		sizet size;
+
+		/// Room for prev pointer of first block
+		void * unused[2];
+	};
+
+protected:
+	/// Empty list sentinel
+	BlockHeader nullBlock;
+
+	/// First level bitmap
+	uint64 flBitmap;
+
+	/// Second level bitmaps
+	uint32 slBitmaps[flIndexCount];
+
+	/// Heads of free lists
+	BlockHeader * blocks[flIndexCount][slIndexCount];
+
+	/// List of memory areas
+	Area * areas;
+
+	/// Minimum size of a memory area
+	sizet areaSize;
+
+	/// Global lock
+	CriticalSection cs;
+
+protected:
+	/// Block pointer conversions
+	/// @{
+	static FORCE_INLINE BlockHeader * getBlock(void * ptr) { return reinterpret_cast<BlockHeader*>(reinterpret_cast<uintP>(ptr) - blockStartOffset); }
+	static FORCE_INLINE void * getPtr(BlockHeader * block) { return reinterpret_cast<void*>(reinterpret_cast<uintP>(block) + blockStartOffset); }
+	static FORCE_INLINE BlockHeader * offsetToBlock(void * ptr, intP offset) { return reinterpret_cast<BlockHeader*>(reinterpret_cast<intP>(ptr) + offset); }
+	/// @}
+
+	/// Returns next physical block
+	static FORCE_INLINE BlockHeader * getNextBlock(BlockHeader * block)
+	{
+		return offsetToBlock(getPtr(block), block->getSize() - blockHeaderOverhead);
+	}
+
+	/// Links block with next physical block
+	static FORCE_INLINE BlockHeader * linkNextBlock(BlockHeader * block)
+	{
+		BlockHeader * next = getNextBlock(block);
+		next->prevPhys = block;
+		return next;
+	}
+
+	/// Marks block as free, and as such in the next block
+	static FORCE_INLINE void markAsFree(BlockHeader * block)
+	{
+		linkNextBlock(block)->setPrevFree();
+		block->setFree();
+	}
+
+	/// Marks block as used, and as such in the next block
+	static FORCE_INLINE void markAsUsed(BlockHeader * block)
+	{
+		getNextBlock(block)->setPrevUsed();
+		block->setUsed();
+	}
+
+	/// Returns index of most significant bit
+	static FORCE_INLINE uint32 getLastBit(uint64 n)
+	{
+		return 63 - PlatformMath::getLeadingZeros(n);
+	}
+
+	/// Returns first and second level indices of size
+	static FORCE_INLINE void mappingInsert(sizet n, uint32 & fl, uint32 & sl)
+	{
+		if (n < smallBlockSize)
+		{
+			// Small blocks share first list
+			fl = 0;
+			sl = uint32(n / (smallBlockSize / slIndexCount));
+		}
+		else
+		{
+			fl = getLastBit(n);
+			sl = uint32(n >> (fl - slIndexCountLog2)) ^ slIndexCount;
+			fl -= flIndexShift - 1;
+		}
+	}
+
+	/// Returns indices of the first list whose
+	/// blocks are all larger than size
+	static FORCE_INLINE void mappingSearch(sizet n, uint32 & fl, uint32 & sl)
+	{
+		if (n >= smallBlockSize) n += (sizet(1) << (getLastBit(n) - slIndexCountLog2)) - 1;
+		mappingInsert(n, fl, sl);
+	}
+
+	/// Rounds request size to a valid block size, 0 if too large
+	static FORCE_INLINE sizet adjustRequestSize(sizet n, sizet alignment)
+	{
+		const sizet aligned = PlatformMath::alignUp(n, alignment);
+		return aligned < blockSizeMax ? PlatformMath::max(aligned, blockSizeMin) : 0;
+	}
+
+	/// Free lists management
+	/// @{
+	BlockHeader * searchSuitableBlock(uint32 & fl, uint32 & sl);
+	void removeFreeBlock(BlockHeader * block, uint32 fl, uint32 sl);
+	void insertFreeBlock(BlockHeader * block, uint32 fl, uint32 sl);
+	void removeBlock(BlockHeader * block);
+	void insertBlock(BlockHeader * block);
+	/// @}
+
+	/// Blocks split and merge
+	/// @{
+	BlockHeader * splitBlock(BlockHeader * block, sizet n);
+	BlockHeader * absorbBlock(BlockHeader * prev, BlockHeader * block);
+	BlockHeader * mergePrevBlock(BlockHeader * block);
+	BlockHeader * mergeNextBlock(BlockHeader * block);
+	void trimFreeBlock(BlockHeader * block, sizet n);
+	void trimUsedBlock(BlockHeader * block, sizet n);
+	BlockHeader * trimFreeLeadingBlock(BlockHeader * block, sizet n);
+	/// @}
+
+	/// Finds and removes a free block of at least n Bytes
+	BlockHeader * locateFreeBlock(sizet n);
+
+	/// Maps a new area large enough for a n Bytes block
+	bool addArea(sizet n);
+
+public:
+	/**
+	 * Default constructor
+	 * 
+	 * @param [in] _areaSize minimum size of a memory
+	 * 	area, the first area is mapped immediately
+	 */
+	MallocTLSF(sizet _areaSize = MALLOC_TLSF_AREA_SIZE);
+
+	/// Destructor, unmaps all areas
+	~MallocTLSF();
+
+	//////////////////////////////////////////////////
+	// Malloc interface
+	//////////////////////////////////////////////////
+
+	/// @copydoc Malloc::malloc()
+	virtual void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::realloc()
+	virtual void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::free()
+	virtual void free(void * original) override;
+
+	/// @copydoc Malloc::getAllocSize()
+	virtual bool getAllocSize(void * original, sizet & n) override;
+};
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "core_types.h"
+#include "platform_memory.h"
+#include "platform_math.h"
+#include "platform_atomics.h"
+#include "platform_threads.h"
+#include "critical_section.h"
+
+#define MALLOC_TRACKER_MAX_TAGS 64			// Max number of distinct tags
+#define MALLOC_TRACKER_HISTOGRAM_BINS 32	// Number of power of two size bins
+
+/**
+ * @class MallocTracker hal/malloc_tracker.h
+ * 
+ * A decorator that records statistics of the
+ * blocks allocated through another allocator.
+ * 
+ * Each block is attributed to the tag that is
+ * current on the allocating thread. A tag is
+ * pushed for the rest of a scope with @ref
+ * MALLOC_TAG, or @ref MALLOC_TAG_CALLSITE to
+ * use the file and line as tag:
+ * 
+ * ```
+ * MALLOC_TAG("Render");
+ * Array<Vertex> vertices(numVertices);
+ * ```
+ * 
+ * For each tag the tracker records number of
+ * allocations and frees, live and peak Bytes and
+ * a histogram of sizes. Counters are updated with
+ * atomic adds, a small header before each block
+ * holds its size and tag, so that frees are
+ * charged to the owner from any thread.
+ * Sized and batch calls are forwarded to the
+ * tracked allocator, accounting for the header.
+ * 
+ * gMalloc is wrapped in a tracker when
+ * SGL_MALLOC_TRACKER is set, which is the
+ * default in debug and development builds.
+ */
+class MallocTracker : public Malloc
+{
+public:
+	/// Statistics of a tag
+	struct GCC_ALIGN(64) TagStats
+	{
+		/// Number of allocations and frees
+		/// @{
+		uint64 numAllocs;
+		uint64 numFrees;
+		/// @}
+
+		/// Live and peak Bytes
+		/// @{
+		uint64 currBytes;
+		uint64 peakBytes;
+		/// @}
+
+		/// Number of allocations with size in [2^i, 2^(i + 1))
+		uint64 histogram[MALLOC_TRACKER_HISTOGRAM_BINS];
+	};
+
+	/// Pushes a tag on construction, pops it on destruction
+	class ScopedTag
+	{
+	protected:
+		/// Tag to restore
+		uint32 prevTag;
+
+	public:
+		/// Default constructor
+		FORCE_INLINE ScopedTag(uint32 tag) : prevTag(getCurrentTag())
+		{
+			setCurrentTag(tag);
+		}
+
+		/// Destructor
+		FORCE_INLINE ~ScopedTag()
+		{
+			setCurrentTag(prevTag);
+		}
+	};
+
+protected:
+	/// Block header
+	struct Header
+	{
+		/// Tag of the block
+		uint32 tag;
+
+		/// Offset of the block from the inner block
+		uint32 offset;
+
+		/// Requested size in Bytes
+		sizet size;
+	};
+
+	/// Tracked allocator
+	Malloc * innerMalloc;
+
+	/// Per-tag statistics
+	TagStats stats[MALLOC_TRACKER_MAX_TAGS];
+
+protected:
+	/// Returns header of block
+	static FORCE_INLINE Header * getHeader(void * original)
+	{
+		return reinterpret_cast<Header*>(original) - 1;
+	}
+
+	/// Returns offset of a block with the given alignment
+	static FORCE_INLINE sizet getOffset(uint32 alignment)
+	{
+		return PlatformMath::alignUp(sizeof(Header), alignment);
+	}
+
+	/// Returns histogram bin of size
+	static FORCE_INLINE uint32 getHistogramBin(sizet n)
+	{
+		return n ? PlatformMath::min<uint32>(63 - PlatformMath::getLeadingZeros(n), MALLOC_TRACKER_HISTOGRAM_BINS - 1) : 0;
+	}
+
+	/// Adds n Bytes to live Bytes of tag, updates peak
+	static void addBytes(TagStats & tagStats, int64 n);
+
+	/// Records count new blocks of n Bytes
+	void trackAlloc(uint32 tag, sizet n, uint32 count = 1);
+
+	/// Records a block resized from prevN to n Bytes
+	void trackRealloc(uint32 tag, sizet prevN, sizet n);
+
+	/// Records a freed block of n Bytes
+	void trackFree(uint32 tag, sizet n);
+
+	/// Returns TLS slot of current tag
+	static uint32 getTagSlot();
+
+	/// Sets tag of calling thread
+	static FORCE_INLINE void setCurrentTag(uint32 tag)
+	{
+		PlatformTLS::setValue(getTagSlot(), reinterpret_cast<void*>(uintP(tag)));
+	}
+
+public:
+	/**
+	 * Default constructor
+	 * 
+	 * @param [in] _innerMalloc allocator to track, if
+	 * 	null gMalloc is used
+	 */
+	MallocTracker(Malloc * _innerMalloc = nullptr);
+
+	/**
+	 * Returns index of a tag, registers it if
+	 * necessary. Tags are shared by all trackers,
+	 * tag 0 is the untagged tag
+	 * 
+	 * @param [in] name tag name, must outlive trackers
+	 * @return tag index, 0 if no more tags are available
+	 */
+	static uint32 registerTag(const char * name);
+
+	/// Returns name of tag
+	static const char * getTagName(uint32 tag);
+
+	/// Returns number of registered tags
+	static uint32 getNumTags();
+
+	/// Returns tag of calling thread
+	static FORCE_INLINE uint32 getCurrentTag()
+	{
+		return uint32(reinterpret_cast<uintP>(PlatformTLS::getValue(getTagSlot())));
+	}
+
+	/// Returns a snapshot of the statistics of tag
+	TagStats getTagStats(uint32 tag) const;
+
+	/// Writes a report of all tags with allocations
+	void dumpReport(FILE * out = stdout) const;
+
+	//////////////////////////////////////////////////
+	// Malloc interface
+	//////////////////////////////////////////////////
+
+	/// @copydoc Malloc::malloc()
+	virtual void * malloc(sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::realloc()
+	virtual void * realloc(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::free()
+	virtual void free(void * original) override;
+
+	/// @copydoc Malloc::freeSized()
+	virtual void freeSized(void * original, sizet n, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::mallocBatch()
+	virtual uint32 mallocBatch(sizet n, uint32 count, void ** out, uint32 alignment = DEFAULT_ALIGNMENT) override;
+
+	/// @copydoc Malloc::freeBatch()
+	virtual void freeBatch(void ** originals, uint32 count) override;
+
+	/// @copydoc Malloc::getAllocSize()
+	virtual bool getAllocSize(void * original, sizet & n) override;
+
+	/// @copydoc Malloc::trim()
+	virtual void trim() override;
+
+	/// Writes stats of the tracked allocator
+	virtual bool writeStats(FILE * out) override;
+};
+
+#define MALLOC_TRACKER_CONCAT_IMPL(a, b) a##b
+#define MALLOC_TRACKER_CONCAT(a, b) MALLOC_TRACKER_CONCAT_IMPL(a, b)
+#define MALLOC_TRACKER_STRINGIFY_IMPL(x) #x
+#define MALLOC_TRACKER_STRINGIFY(x) MALLOC_TRACKER_STRINGIFY_IMPL(x)
+
+#if SGL_MALLOC_TRACKER
+	/// Tags allocations until the end of the scope
+	#define MALLOC_TAG(name) \
+		static const uint32 MALLOC_TRACKER_CONCAT(mallocTagId, __LINE__) = MallocTracker::registerTag(name); \
+		MallocTracker::ScopedTag MALLOC_TRACKER_CONCAT(mallocTagScope, __LINE__)(MALLOC_TRACKER_CONCAT(mallocTagId, __LINE__))
+#else
+	#define MALLOC_TAG(name)
+#endif
+
+/// Tags allocations until the end of the scope with file and line
+#define MALLOC_TAG_CALLSITE() MALLOC_TAG(__FILE__ ":" MALLOC_TRACKER_STRINGIFY(__LINE__))
@@ -18,6 +18,9 @@ enum
 class Malloc
 {
 public:
+	/// Allocators may be deleted through a base pointer
+	virtual ~Malloc() = default;
+
 	/**
 	 * @brief Memory allocation
 	 * 
@@ -46,6 +49,44 @@ public:
 	 */
 	virtual void free(void * original) = 0;
 
+	/**
+	 * @brief Memory deallocation with known size,
+	 * allocators may use it to skip the block lookup
+	 * 
+	 * @param [in]	original	originally allocated block
+	 * @param [in]	n			size requested on allocation
+	 * @param [in]	alignment	alignment requested on allocation
+	 */
+	virtual void freeSized(void * original, uintP n, uint32 alignment = DEFAULT_ALIGNMENT) { free(original); }
+
+	/**
+	 * @brief Allocate many blocks of the same size
+	 * 
+	 * @param [in]	n			number of Bytes of each block
+	 * @param [in]	count		number of blocks
+	 * @param [out]	out			allocated blocks
+	 * @param [in]	alignment	memory alignment
+	 * 
+	 * @return number of allocated blocks, less than count if out of memory
+	 */
+	virtual uint32 mallocBatch(uintP n, uint32 count, void ** out, uint32 alignment = DEFAULT_ALIGNMENT)
+	{
+		uint32 i = 0;
+		for (; i < count && (out[i] = malloc(n, alignment)); ++i);
+		return i;
+	}
+
+	/**
+	 * @brief Deallocate many blocks
+	 * 
+	 * @param [in] originals	originally allocated blocks
+	 * @param [in] count		number of blocks
+	 */
+	virtual void freeBatch(void ** originals, uint32 count)
+	{
+		for (uint32 i = 0; i < count; ++i) free(originals[i]);
+	}
+
 	/**
 	 * @brief Return allocation size if possible
 	 * 
@@ -55,5 +96,86 @@ public:
 	 * @return @c true if possible, @c false otherwise
 	 */
 	virtual bool getAllocSize(void * original, uintP & n) { return false; }
+
+	/**
+	 * @brief Give back unused memory to the OS,
+	 * if the allocator supports it
+	 */
+	virtual void trim() {}
+
+	/**
+	 * @brief Write allocator statistics as a single
+	 * line JSON object, if the allocator supports it
+	 * 
+	 * @param [in] out output stream
+	 * 
+	 * @return @c true if possible, @c false otherwise
+	 */
+	virtual bool writeStats(FILE * out) { return false; }
 };
 
+/**
+ * @class MallocBatch hal/memory_base.h
+ * 
+ * Hands out a known number of blocks of the same
+ * size, allocated in batches with @ref
+ * Malloc::mallocBatch(). Blocks not handed out
+ * are freed on destruction
+ */
+template<typename AllocT, uint32 batchSize = 32>
+class MallocBatch
+{
+protected:
+	/// Allocator in use
+	AllocT * allocator;
+
+	/// Block size and alignment
+	/// @{
+	uintP blockSize;
+	uint32 alignment;
+	/// @}
+
+	/// Number of blocks still to allocate
+	uint64 numRemaining;
+
+	/// Current batch
+	/// @{
+	void * blocks[batchSize];
+	uint32 numBlocks;
+	uint32 curr;
+	/// @}
+
+public:
+	/// Default constructor, blocks are allocated on first use
+	FORCE_INLINE MallocBatch(AllocT * _allocator, uintP _blockSize, uint64 count, uint32 _alignment = DEFAULT_ALIGNMENT) :
+		allocator(_allocator),
+		blockSize(_blockSize),
+		alignment(_alignment),
+		numRemaining(count),
+		numBlocks(0),
+		curr(0) {}
+
+	/// Destructor, frees unused blocks
+	FORCE_INLINE ~MallocBatch()
+	{
+		if (curr < numBlocks) allocator->freeBatch(blocks + curr, numBlocks - curr);
+	}
+
+	/// Returns next block
+	FORCE_INLINE void * malloc()
+	{
+		if (UNLIKELY(curr == numBlocks))
+		{
+			// Allocate next batch
+			const uint32 count = numRemaining < batchSize ? uint32(numRemaining) : batchSize;
+			numBlocks = count ? allocator->mallocBatch(blockSize, count, blocks, alignment) : 0;
+			numRemaining -= numBlocks;
+			curr = 0;
+
+			// More blocks than expected or out of memory
+			if (UNLIKELY(numBlocks == 0)) return allocator->malloc(blockSize, alignment);
+		}
+
+		return blocks[curr++];
+	}
+};
\ No newline at end of file
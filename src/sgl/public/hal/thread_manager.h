@@ -4,7 +4,7 @@
 #include "templates/singleton.h"
 #include "hal/critical_section.h"
 #include "containers/string.h"
-#include "containers/map.h"
+#include "containers/hash_map.h"
 
 /// Forward declare
 class RunnableThread;
@@ -17,7 +17,7 @@ class ThreadManager : public Singleton<ThreadManager>
 {
 protected:
 	/// @brief List of thread objects
-	Map<uint64, RunnableThread*, MallocBinned> threads;
+	HashMap<uint64, RunnableThread*> threads;
 
 	/// @brief Critical section for threads list access
 	CriticalSection threadsCS;
@@ -40,7 +40,7 @@ public:
 	{
 		// Acquire lock
 		ScopeLock scopeLock(&threadsCS);
-		/** Not implemented */
+		threads.remove(id);
 	};
 	void remove(RunnableThread * thread);
 	/// @}
@@ -7,8 +7,32 @@
 	#define SGL_BUILD_DEBUG 0
 #endif
 #ifndef SGL_BUILD_DEVELOPMENT
-	#define SGL_SGL_BUILD_DEVELOPMENT 0
+	#define SGL_BUILD_DEVELOPMENT 0
 #endif
 #ifndef SGL_BUILD_RELEASE
 	#define SGL_BUILD_RELEASE 0
 #endif
+
+/// Global allocator selection, set from CMake
+/// Defaults to the platform base allocator
+
+#ifndef SGL_GMALLOC_BINNED
+	#define SGL_GMALLOC_BINNED 0
+#endif
+#ifndef SGL_GMALLOC_TLSF
+	#define SGL_GMALLOC_TLSF 0
+#endif
+
+/// Route global operator new and delete
+/// to gMalloc, set from CMake
+
+#ifndef SGL_GMALLOC_OPERATORS
+	#define SGL_GMALLOC_OPERATORS 0
+#endif
+
+/// Allocation tracking, on by default
+/// in debug and development builds
+
+#ifndef SGL_MALLOC_TRACKER
+	#define SGL_MALLOC_TRACKER (SGL_BUILD_DEBUG | SGL_BUILD_DEVELOPMENT)
+#endif
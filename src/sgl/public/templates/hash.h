@@ -0,0 +1,100 @@
+#pragma once
+
+#include "core_types.h"
+#include "hal/platform_memory.h"
+#include "hal/platform_string.h"
+#include "templates/enable_if.h"
+#include "templates/is_integral.h"
+#include "templates/is_pointer.h"
+
+/**
+ * Hash functions
+ * 
+ * All hashes are 64 bit wide, and all bits are
+ * well mixed, so that hash tables can use both
+ * the low and the high bits
+ * @{
+ */
+/// Mixes the bits of an integer (MurmurHash3 finalizer)
+static CONSTEXPR FORCE_INLINE uint64 hashInteger(uint64 x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/// Hashes a buffer of bytes, 8 bytes at a time
+static FORCE_INLINE uint64 hashBytes(const void * buffer, sizet n)
+{
+	const uint8 * bytes = reinterpret_cast<const uint8*>(buffer);
+	uint64 h = 0x9e3779b97f4a7c15ULL ^ n;
+
+	for (; n >= 8; bytes += 8, n -= 8)
+	{
+		uint64 chunk;
+		PlatformMemory::memcpy(&chunk, bytes, 8);
+		h = hashInteger(h ^ chunk);
+	}
+
+	// Remaining bytes
+	uint64 chunk = 0;
+	PlatformMemory::memcpy(&chunk, bytes, n);
+
+	return hashInteger(h ^ chunk);
+}
+
+/// Hashes a null-terminated string
+static FORCE_INLINE uint64 getHash(const ansichar * string)
+{
+	return hashBytes(string, PlatformString::strlen(string));
+}
+/// @}
+
+/**
+ * @class Hash templates/hash.h
+ * 
+ * Default hash function object. Integers and
+ * pointers are mixed, strings are hashed by
+ * content. Other types must provide a free
+ * function found by argument-dependent lookup:
+ * 
+ * ```
+ * uint64 getHash(const Handle & handle);
+ * ```
+ * 
+ * Types that can be compared with each other,
+ * e.g. String and const ansichar*, must have
+ * the same hash (see @ref HashMap::find())
+ */
+struct Hash
+{
+	/// Integers and pointers
+	template<typename T>
+	FORCE_INLINE typename EnableIf<IsIntegral<T>::value || IsPointer<T>::value, uint64>::Type operator()(T x) const
+	{
+		return hashInteger(uint64(x));
+	}
+
+	/// Strings, mutable buffers are hashed by
+	/// content as well
+	/// @{
+	FORCE_INLINE uint64 operator()(const ansichar * string) const
+	{
+		return getHash(string);
+	}
+	FORCE_INLINE uint64 operator()(ansichar * string) const
+	{
+		return getHash(string);
+	}
+	/// @}
+
+	/// Any type that provides getHash()
+	template<typename T>
+	FORCE_INLINE typename EnableIf<!IsIntegral<T>::value && !IsPointer<T>::value, uint64>::Type operator()(const T & x) const
+	{
+		return getHash(x);
+	}
+};
\ No newline at end of file
@@ -49,12 +49,9 @@ template<typename T>
 FORCE_INLINE typename EnableIf<!IsTriviallyCopyable<T>::value, void>::Type moveOrCopy(T * dest, const T * src, int64 n)
 {
 	// Copy construct each element
-	uint64 i = 0;
+	int64 i = 0;
 
-	/// @todo remove
-	printf("not trivially copyable eh eh");
-
-	for (; i < n - 8; i += 8)
+	for (; i + 8 <= n; i += 8)
 	{
 			  T * _dest	= dest + i;
 		const T * _src	= src + i;
@@ -68,7 +65,7 @@ FORCE_INLINE typename EnableIf<!IsTriviallyCopyable<T>::value, void>::Type moveO
 		new (_dest + 6) T(_src[6]);
 		new (_dest + 7) T(_src[7]);
 	}
-	for (; i < n - 4; i += 4)
+	for (; i + 4 <= n; i += 4)
 	{
 			  T * _dest	= dest + i;
 		const T * _src	= src + i;
@@ -82,25 +79,3 @@ FORCE_INLINE typename EnableIf<!IsTriviallyCopyable<T>::value, void>::Type moveO
 		new (dest + i) T(src[i]);
 }
 /// @}
-
-/**
- * Swap two values
- * 
- * @param [in] a,b values to swap
- * @{
- */
-template<typename T>
-FORCE_INLINE typename EnableIf<IsTriviallyCopyable<T>::value, void>::Type swap(T & a, T & b)
-{
-	T t = a;
-	a = b;
-	b = t;
-}
-template<typename T>
-FORCE_INLINE typename EnableIf<!IsTriviallyCopyable<T>::value, void>::Type swap(T & a, T & b)
-{
-	T t(a);
-	new (&a) T(b);
-	new (&b) T(t);
-}
-/// @}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "core_types.h"
+#include "hal/platform_memory.h"
+#include "templates/enable_if.h"
+#include "templates/is_trivially_copyable.h"
+
+/**
+ * Sets value to true if objects can be moved to
+ * another address with a memcpy, without calling
+ * move constructor and destructor. Trivially
+ * copyable types are relocatable, other types
+ * opt in with a specialization:
+ * 
+ * ```
+ * template<> struct IsTriviallyRelocatable<Handle> { enum {value = true}; };
+ * ```
+ * 
+ * Types that point to themselves, or that are
+ * pointed to by other objects, must not opt in
+ */
+template<typename T>
+struct IsTriviallyRelocatable { enum {value = IsTriviallyCopyable<T>::value}; };
+
+/**
+ * Swap two values
+ * 
+ * @param [in] a,b values to swap
+ * @{
+ */
+template<typename T>
+FORCE_INLINE typename EnableIf<IsTriviallyRelocatable<T>::value, void>::Type swap(T & a, T & b)
+{
+	PlatformMemory::memswap(&a, &b, sizeof(T));
+}
+template<typename T>
+FORCE_INLINE typename EnableIf<!IsTriviallyRelocatable<T>::value, void>::Type swap(T & a, T & b)
+{
+	T t(std::move(a));
+	a = std::move(b);
+	b = std::move(t);
+}
+/// @}
\ No newline at end of file
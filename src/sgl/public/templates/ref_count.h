@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core_types.h"
+#include "templates/is_trivially_relocatable.h"
 
 /**
  * @class RefCountPtr templates/ref_count.h
@@ -80,3 +81,7 @@ protected:
 	RefT * ref;
 };
 
+/// Ref pointers are relocatable, the reference
+/// doesn't know where it is stored
+template<class RefT>
+struct IsTriviallyRelocatable<RefCountPtr<RefT>> { enum {value = true}; };
@@ -63,5 +63,47 @@ using PlatformAtomics = struct UnixPlatformAtomics
 	{
 		__atomic_store((volatile Int*)src, &val, __ATOMIC_RELAXED);
 	}
+
+	template<typename Int, typename T = Int>
+	static FORCE_INLINE typename EnableIf<IsIntegral<Int>::value & IsIntegral<T>::value, Int>::Type compareExchange(volatile Int * dest, T comparand, T exchange)
+	{
+		return __sync_val_compare_and_swap(dest, comparand, exchange);
+	}
+
+	template<typename T>
+	static FORCE_INLINE T * read(T * volatile const * src)
+	{
+		return __atomic_load_n(src, __ATOMIC_SEQ_CST);
+	}
+
+	template<typename T>
+	static FORCE_INLINE T * readRelaxed(T * volatile const * src)
+	{
+		return __atomic_load_n(src, __ATOMIC_RELAXED);
+	}
+
+	template<typename T>
+	static FORCE_INLINE void store(T * volatile * src, T * val)
+	{
+		__atomic_store_n(src, val, __ATOMIC_SEQ_CST);
+	}
+
+	template<typename T>
+	static FORCE_INLINE void storeRelaxed(T * volatile * src, T * val)
+	{
+		__atomic_store_n(src, val, __ATOMIC_RELAXED);
+	}
+
+	template<typename T>
+	static FORCE_INLINE T * exchange(T * volatile * dest, T * exchange)
+	{
+		return __atomic_exchange_n(dest, exchange, __ATOMIC_SEQ_CST);
+	}
+
+	template<typename T>
+	static FORCE_INLINE T * compareExchange(T * volatile * dest, T * comparand, T * exchange)
+	{
+		return __sync_val_compare_and_swap(dest, comparand, exchange);
+	}
 };
 
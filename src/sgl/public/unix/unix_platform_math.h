@@ -9,5 +9,15 @@
  */
 using PlatformMath = struct UnixPlatformMath : public GenericPlatformMath
 {
-	// Empty
+	/// @copydoc GenericPlatformMath::getLeadingZeros
+	static CONSTEXPR FORCE_INLINE uint32 getLeadingZeros(uint64 n)
+	{
+		return __builtin_clzll(n);
+	}
+
+	/// @copydoc GenericPlatformMath::getTrailingZeros
+	static CONSTEXPR FORCE_INLINE uint32 getTrailingZeros(uint64 n)
+	{
+		return __builtin_ctzll(n);
+	}
 };
\ No newline at end of file
@@ -1,13 +1,56 @@
 #pragma once
 
 #include "core_types.h"
+#include "unix_system_includes.h"
+#include <sys/mman.h>
 
 /**
  * @struct UnixPlatformMemory unix/unix_platform_memory.h
  */
 struct UnixPlatformMemory : public GenericPlatformMemory
 {
-	// Empty
+	/// @copydoc GenericPlatformMemory::getPageSize()
+	static FORCE_INLINE sizet getPageSize()
+	{
+		static const sizet pageSize = ::sysconf(_SC_PAGESIZE);
+		return pageSize;
+	}
+
+	/// @copydoc GenericPlatformMemory::decommit()
+	static FORCE_INLINE bool decommit(void * ptr, sizet size)
+	{
+		// Pages are zero-filled on next access
+		return size == 0 || ::madvise(ptr, size, MADV_DONTNEED) == 0;
+	}
+
+	/// @copydoc GenericPlatformMemory::map()
+	static void * map(sizet size, sizet alignment = 0, bool bHugePages = false);
+
+	/// @copydoc GenericPlatformMemory::unmap()
+	static FORCE_INLINE bool unmap(void * ptr, sizet size)
+	{
+		return ::munmap(ptr, size) == 0;
+	}
+
+	/// @copydoc GenericPlatformMemory::remap()
+	static FORCE_INLINE void * remap(void * ptr, sizet oldSize, sizet newSize)
+	{
+	#ifdef MREMAP_MAYMOVE
+		void * out = ::mremap(ptr, oldSize, newSize, MREMAP_MAYMOVE);
+		return out != MAP_FAILED ? out : nullptr;
+	#else
+		return nullptr;
+	#endif
+	}
+
+	/// @copydoc GenericPlatformMemory::getNumNodes()
+	static uint32 getNumNodes();
+
+	/// @copydoc GenericPlatformMemory::getCurrentNode()
+	static uint32 getCurrentNode();
+
+	/// @copydoc GenericPlatformMemory::bindToNode()
+	static bool bindToNode(void * ptr, sizet size, uint32 node);
 };
 typedef UnixPlatformMemory PlatformMemory;
 
@@ -17,19 +17,25 @@ struct UnixPlatformTLS : public GenericPlatformTLS
 		return static_cast<uint64>(pthread_self());
 	}
 
-	/// @brief Allocate a TLS slot
-	static FORCE_INLINE uint32 allocateSlot()
+	/**
+	 * @brief Allocate a TLS slot
+	 * 
+	 * @param [in] destructor optional function called with the slot value on thread exit
+	 * 
+	 * @return slot index
+	 */
+	static FORCE_INLINE uint32 allocateSlot(void (*destructor)(void*) = nullptr)
 	{
 		// Create tls key
 		pthread_key_t key = 0;
-		if (pthread_key_create(&key, nullptr) != 0) return static_cast<uint32>(-1);
+		if (pthread_key_create(&key, destructor) != 0) return static_cast<uint32>(-1);
 
 		// -1 is invalid
 		if (UNLIKELY(static_cast<uint32>(key) == static_cast<uint32>(-1)))
 		{
 			// Create a new key
 			pthread_key_t _key = 0;
-			if (pthread_key_create(&_key, nullptr) != 0)
+			if (pthread_key_create(&_key, destructor) != 0)
 			{
 				pthread_key_delete(key);
 				return static_cast<uint32>(-1);
@@ -56,7 +62,7 @@ struct UnixPlatformTLS : public GenericPlatformTLS
 	 * 
 	 * @return retrieved value
 	 */
-	static FORCE_INLINE void * getValue(uint32 slot) { pthread_getspecific(static_cast<pthread_key_t>(slot)); }
+	static FORCE_INLINE void * getValue(uint32 slot) { return pthread_getspecific(static_cast<pthread_key_t>(slot)); }
 
 	/// @brief Clears slot
 	static FORCE_INLINE void clear(uint32 slot) { pthread_key_delete(static_cast<pthread_key_t>(slot)); }
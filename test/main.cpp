@@ -1,9 +1,13 @@
 #include "public/test_containers.h"
 #include "public/test_math.h"
+#include "public/test_memory.h"
 
 /// @brief Global allocator
 Malloc * gMalloc = nullptr;
 
+/// @brief Global per-frame allocator
+MallocLinear * gFrameMalloc = nullptr;
+
 /**
  * @brief Run all unit tests
  * 
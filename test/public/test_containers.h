@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <chrono>
+#include <unordered_map>
 
 #include "hal/platform_memory.h"
 #include "containers/array.h"
@@ -6,7 +8,12 @@
 #include "containers/queue.h"
 #include "containers/string.h"
 #include "containers/map.h"
+#include "containers/hash_map.h"
+#include "containers/hash_set.h"
+#include "containers/sorting.h"
 #include "containers/containers.h"
+#include "hal/malloc_tlsf.h"
+#include "math/math.h"
 
 /**
  * @note All tests are run using the default allocator.
@@ -59,6 +66,203 @@ TEST(Containers, arr_test)
 	for (const auto elem : *array) EXPECT_TRUE(elem & 0x1); */
 }
 
+TEST(Containers, arr_inline)
+{
+	// Stays inline until it grows past N elements
+	InlineArray<uint64, 8> array;
+	for (uint64 i = 0; i < 8; ++i) array.push(i);
+	EXPECT_TRUE(array.getAllocator().isInline(*array));
+
+	array.push(8);
+	EXPECT_FALSE(array.getAllocator().isInline(*array));
+	for (uint64 i = 0; i < 9; ++i) EXPECT_EQ(i, array[i]);
+
+	// Inline buffers are copied on move
+	InlineArray<uint64, 8> small;
+	for (uint64 i = 0; i < 4; ++i) small.push(i);
+
+	InlineArray<uint64, 8> moved(std::move(small));
+	EXPECT_TRUE(moved.getAllocator().isInline(*moved));
+	EXPECT_EQ(4, moved.getCount());
+	for (uint64 i = 0; i < 4; ++i) EXPECT_EQ(i, moved[i]);
+}
+
+/// A non trivial type that counts live objects
+struct ArrayItem
+{
+	static int32 live;
+	String name;
+
+	ArrayItem(const ansichar * _name) : name(_name) { ++live; }
+	ArrayItem(const ArrayItem & other) : name(other.name) { ++live; }
+	ArrayItem(ArrayItem && other) : name(std::move(other.name)) { ++live; }
+	~ArrayItem() { --live; }
+};
+int32 ArrayItem::live = 0;
+
+TEST(Containers, arr_emplace)
+{
+	{
+		Array<ArrayItem> array;
+		for (uint64 i = 0; i < 100; ++i) array.emplace(i & 1 ? "a string long enough to spill to the heap" : "short");
+		EXPECT_EQ(100, ArrayItem::live);
+
+		array.emplaceAt(0, "first");
+		array.emplaceAt(50, "middle");
+		EXPECT_EQ(102, array.getCount());
+		EXPECT_TRUE(array[0].name == "first");
+		EXPECT_TRUE(array[1].name == "short");
+		EXPECT_TRUE(array[50].name == "middle");
+		EXPECT_TRUE(array[101].name == "a string long enough to spill to the heap");
+
+		array.removeAt(0, 2);
+		array.pop();
+		EXPECT_EQ(99, array.getCount());
+		EXPECT_EQ(99, ArrayItem::live);
+		EXPECT_TRUE(array[0].name == "a string long enough to spill to the heap");
+		EXPECT_TRUE(array[48].name == "middle");
+
+		// Reserve and shrink
+		array.reserve(1000);
+		EXPECT_GE(array.getSize(), 1000);
+		array.shrinkToFit();
+		EXPECT_EQ(99, array.getSize());
+		EXPECT_TRUE(array[98].name == "short");
+
+		// Self assignment keeps items
+		Array<ArrayItem> & self = array;
+		array = self;
+		EXPECT_EQ(99, array.getCount());
+		EXPECT_EQ(99, ArrayItem::live);
+		EXPECT_TRUE(array[48].name == "middle");
+	}
+
+	{
+		// Inline items are relocated on move
+		InlineArray<ArrayItem, 4> array;
+		array.emplace("a string long enough to spill to the heap");
+		array.emplace("short");
+
+		InlineArray<ArrayItem, 4> moved(std::move(array));
+		EXPECT_EQ(2, ArrayItem::live);
+		EXPECT_EQ(0, array.getCount());
+		EXPECT_TRUE(moved[0].name == "a string long enough to spill to the heap");
+
+		// Moved-from array is still usable
+		array.emplace("again");
+		EXPECT_EQ(1, array.getCount());
+		EXPECT_EQ(3, ArrayItem::live);
+	}
+
+	// Destructor destroys all items
+	EXPECT_EQ(0, ArrayItem::live);
+}
+
+/// A relocatable type that counts constructions
+struct RelocatableItem
+{
+	static int32 moves;
+	uint64 value;
+
+	RelocatableItem(uint64 _value = 0) : value(_value) {}
+	RelocatableItem(const RelocatableItem & other) : value(other.value) { ++moves; }
+	RelocatableItem(RelocatableItem && other) : value(other.value) { ++moves; }
+	RelocatableItem & operator=(const RelocatableItem & other) { value = other.value; ++moves; return *this; }
+	~RelocatableItem() {}
+
+	bool operator<(const RelocatableItem & other) const { return value < other.value; }
+	bool operator>(const RelocatableItem & other) const { return value > other.value; }
+};
+int32 RelocatableItem::moves = 0;
+template<> struct IsTriviallyRelocatable<RelocatableItem> { enum {value = true}; };
+
+TEST(Containers, arr_relocatable)
+{
+	static_assert(IsTriviallyRelocatable<uint64>::value, "");
+	static_assert(IsTriviallyRelocatable<Array<String>>::value, "");
+	static_assert(!IsTriviallyRelocatable<String>::value, "");
+	static_assert(!IsTriviallyRelocatable<InlineArray<uint64, 4>>::value, "");
+
+	// Growth, insert and remove don't move items one by one
+	Array<RelocatableItem> array;
+	for (uint64 i = 0; i < 1000; ++i) array.emplace(999 - i);
+	array.emplaceAt(0, 1000);
+	array.removeAt(0);
+	array.shrinkToFit();
+	EXPECT_EQ(0, RelocatableItem::moves);
+
+	// Sort swaps bytes
+	Container::sort(array.begin(), array.end());
+	EXPECT_EQ(0, RelocatableItem::moves);
+	for (uint64 i = 0; i < 1000; ++i) EXPECT_EQ(i, array[i].value);
+
+	// Queue relocates popped data
+	Queue<RelocatableItem> queue;
+	queue.push(RelocatableItem(1));
+	RelocatableItem::moves = 0;
+
+	RelocatableItem item;
+	EXPECT_TRUE(queue.pop(item));
+	EXPECT_EQ(1, item.value);
+	EXPECT_EQ(0, RelocatableItem::moves);
+	EXPECT_EQ(0, queue.getLength());
+}
+
+TEST(Containers, arr_aligned)
+{
+	// Buffers are aligned to alignof(T), with any allocator policy
+	Array<mat4> matrices(1);
+	Array<mat4, StaticAllocator<MallocTLSF>> tlsfMatrices(1);
+	for (uint64 i = 0; i < 4096; ++i) matrices.emplace(float32(i)), tlsfMatrices.emplace(float32(i));
+	EXPECT_EQ(0, reinterpret_cast<uintP>(*matrices) & (alignof(mat4) - 1));
+	EXPECT_EQ(0, reinterpret_cast<uintP>(*tlsfMatrices) & (alignof(mat4) - 1));
+
+	// Sum matrices with aligned loads, and with unaligned
+	// loads on a buffer with the default alignment
+	// Only 16 KB of matrices, so that they stay in L1
+	using DVecOps = mat4::DVecOps;
+	const uint64 numMatrices = 256;
+	const uint64 numRuns = 4096;
+
+	uint8 * unalignedBuffer = reinterpret_cast<uint8*>(gMalloc->malloc((numMatrices + 1) * sizeof(mat4), alignof(mat4))) + DEFAULT_ALIGNMENT;
+	PlatformMemory::memcpy(unalignedBuffer, *matrices, numMatrices * sizeof(mat4));
+
+	auto sum = [&](const float32 * buffer, auto && load) -> float32 {
+
+		// Independent accumulators, so that loads are the bottleneck
+		DVecOps::Type acc[8];
+		for (uint32 j = 0; j < 8; ++j) acc[j] = DVecOps::zero;
+
+		for (uint64 run = 0; run < numRuns; ++run)
+			for (uint64 i = 0; i < numMatrices * 16; i += 64)
+				for (uint32 j = 0; j < 8; ++j) acc[j] = DVecOps::add(acc[j], load(buffer + i + j * 8));
+
+		for (uint32 j = 1; j < 8; ++j) acc[0] = DVecOps::add(acc[0], acc[j]);
+
+		alignas(32) float32 out[8];
+		_mm256_store_ps(out, acc[0]);
+		return out[0];
+	};
+
+	// Warm up
+	sum(reinterpret_cast<const float32*>(*matrices), [](const float32 * p) { return DVecOps::load(p); });
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	const float32 alignedSum = sum(reinterpret_cast<const float32*>(*matrices), [](const float32 * p) { return DVecOps::load(p); });
+	auto end = std::chrono::high_resolution_clock::now();
+	const float64 alignedTime = std::chrono::duration<float64, std::nano>(end - begin).count();
+
+	begin = std::chrono::high_resolution_clock::now();
+	const float32 unalignedSum = sum(reinterpret_cast<const float32*>(unalignedBuffer), [](const float32 * p) { return DVecOps::loadu(p); });
+	end = std::chrono::high_resolution_clock::now();
+	const float64 unalignedTime = std::chrono::duration<float64, std::nano>(end - begin).count();
+
+	EXPECT_FLOAT_EQ(alignedSum, unalignedSum);
+	printf("mat4 sum, aligned: %.2f ns, unaligned: %.2f ns (%.2fx)\n", alignedTime / (numRuns * numMatrices), unalignedTime / (numRuns * numMatrices), unalignedTime / alignedTime);
+
+	gMalloc->free(unalignedBuffer - DEFAULT_ALIGNMENT);
+}
+
 /////////////////////////////////////////////////
 // String test
 /////////////////////////////////////////////////
@@ -66,6 +270,34 @@ TEST(Containers, arr_test)
 TEST(Containers, str_construct)		{ String str("sneppy"); EXPECT_TRUE(strncmp(*str, "sneppy", 6) == 0); }
 TEST(Containers, str_append_cstr)	{ String str("sneppy"); str += "rulez"; EXPECT_TRUE(strncmp(*str, "sneppyrulez", 11) == 0); }
 TEST(Containers, str_append_str)	{ String str("sneppy"); str += String("rulez"); EXPECT_TRUE(strncmp(*str, "sneppyrulez", 11) == 0); }
+TEST(Containers, str_assign)
+{
+	// Buffer of the target has no room for the terminator
+	String str("a string that is exactly forty chars lon");
+	const String longer("a string that is exactly forty-one chars!");
+	ASSERT_EQ(40, str.getLength());
+	ASSERT_EQ(41, longer.getLength());
+
+	str = longer;
+	EXPECT_EQ(41, str.getLength());
+	EXPECT_TRUE(str == longer);
+
+	String other("another string that is forty chars long!");
+	other = String(longer);
+	EXPECT_TRUE(other == longer);
+}
+
+TEST(Containers, str_inline)
+{
+	// Short strings are stored inside the string
+	String str("sneppy");
+	EXPECT_TRUE(*str >= reinterpret_cast<const ansichar*>(&str) && *str < reinterpret_cast<const ansichar*>(&str + 1));
+
+	// Long strings spill to the heap
+	str += "rulez and is a very long string";
+	EXPECT_FALSE(*str >= reinterpret_cast<const ansichar*>(&str) && *str < reinterpret_cast<const ansichar*>(&str + 1));
+	EXPECT_TRUE(strcmp(*str, "sneppyrulez and is a very long string") == 0);
+}
 TEST(Containers, str_comparison)
 {
 
@@ -117,4 +349,207 @@ TEST(Containers, ll_test)
 
 //////////////////////////////////////////////////
 // Map test
-//////////////////////////////////////////////////
\ No newline at end of file
+//////////////////////////////////////////////////
+
+TEST(Containers, hm_test)
+{
+	HashMap<uint64, uint64> map;
+	EXPECT_TRUE(map.find(1ULL) == map.end());
+	EXPECT_TRUE(map.begin() == map.end());
+
+	// Insert
+	for (uint64 i = 0; i < 10000; ++i) map.insert(i * 3, i);
+	EXPECT_EQ(10000, map.getCount());
+	EXPECT_EQ(0, map.insert(0, 1).second);
+
+	uint64 numErrors = 0;
+	for (uint64 i = 0; i < 10000; ++i)
+	{
+		auto it = map.find(i * 3);
+		numErrors += it == map.end() || it->second != i || map.contains(i * 3 + 1);
+	}
+	EXPECT_EQ(0, numErrors);
+
+	// Remove odd keys, leaves tombstones
+	for (uint64 i = 1; i < 10000; i += 2) EXPECT_TRUE(map.remove(i * 3));
+	EXPECT_FALSE(map.remove(3ULL));
+	EXPECT_EQ(5000, map.getCount());
+	for (uint64 i = 0; i < 10000; ++i) numErrors += map.contains(i * 3) != !(i & 1);
+	EXPECT_EQ(0, numErrors);
+
+	// Reinsert with operator[]
+	for (uint64 i = 1; i < 10000; i += 2) map[i * 3] = i;
+	EXPECT_EQ(10000, map.getCount());
+
+	// Iterate in slot order
+	uint64 count = 0, sum = 0;
+	for (const auto & pair : map) ++count, sum += pair.second;
+	EXPECT_EQ(10000, count);
+	EXPECT_EQ(10000 * 9999 / 2, sum);
+
+	// Copy and move
+	HashMap<uint64, uint64> copy(map);
+	HashMap<uint64, uint64> moved(std::move(map));
+	EXPECT_TRUE(map.isEmpty());
+	EXPECT_TRUE(map.find(0ULL) == map.end());
+	for (uint64 i = 0; i < 10000; ++i) numErrors += copy.find(i * 3)->second != i || moved.find(i * 3)->second != i;
+	EXPECT_EQ(0, numErrors);
+
+	// Empty keeps buffer
+	copy.empty();
+	EXPECT_EQ(0, copy.getCount());
+	EXPECT_TRUE(copy.begin() == copy.end());
+	copy.insert(1, 1);
+	EXPECT_EQ(1, copy.find(1ULL)->second);
+}
+
+TEST(Containers, hm_string)
+{
+	HashMap<String, uint64> map;
+	map.insert("sneppy", 1);
+	map.insert("a string long enough to spill to the heap", 2);
+	map[String("lpraat")] = 3;
+
+	// Lookup with c-strings doesn't create strings
+	EXPECT_EQ(1, map.find("sneppy")->second);
+	EXPECT_EQ(2, map.find("a string long enough to spill to the heap")->second);
+	EXPECT_EQ(3, map.find(String("lpraat"))->second);
+	EXPECT_TRUE(map.find("Sneppy") == map.end());
+
+	// Mutable buffers are hashed by content
+	ansichar buffer[] = "sneppy";
+	ansichar * key = buffer;
+	EXPECT_TRUE(map.contains(key));
+
+	// Growth moves strings
+	for (uint64 i = 0; i < 1000; ++i)
+	{
+		ansichar key[32];
+		snprintf(key, sizeof(key), "key%llu", i);
+		map.insert(key, i);
+	}
+	EXPECT_EQ(1003, map.getCount());
+	EXPECT_EQ(1, map.find("sneppy")->second);
+	EXPECT_EQ(500, map.find("key500")->second);
+	EXPECT_TRUE(map.remove("key500"));
+	EXPECT_FALSE(map.contains("key500"));
+}
+
+TEST(Containers, hm_benchmark)
+{
+	const uint64 numKeys = 1 << 16;
+	const uint64 numRuns = 16;
+
+	// Random keys, looked up in a different order
+	Array<uint64> keys(numKeys), lookups(numKeys);
+	uint64 x = 0x9e3779b97f4a7c15ULL;
+	for (uint64 i = 0; i < numKeys; ++i) keys.push(x = hashInteger(x));
+	for (uint64 i = 0; i < numKeys; ++i) lookups.push(keys[hashInteger(i) % numKeys]);
+
+	HashMap<uint64, uint64> hashMap;
+	Map<uint64, uint64> treeMap;
+	std::unordered_map<uint64, uint64> stdMap;
+	for (uint64 i = 0; i < numKeys; ++i) hashMap.insert(keys[i], i), treeMap.insert(keys[i], i), stdMap.emplace(keys[i], i);
+
+	auto bench = [&](const char * name, auto && find) {
+
+		uint64 sum = 0;
+		const auto begin = std::chrono::high_resolution_clock::now();
+		for (uint64 run = 0; run < numRuns; ++run)
+			for (uint64 i = 0; i < numKeys; ++i) sum += find(lookups[i]);
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		printf("%s find: %.2f ns\n", name, std::chrono::duration<float64, std::nano>(end - begin).count() / (numRuns * numKeys));
+		return sum;
+	};
+
+	const uint64 hashSum = bench("HashMap", [&](uint64 key) { return hashMap.find(key)->second; });
+	const uint64 treeSum = bench("Map", [&](uint64 key) { return treeMap.find(key)->second; });
+	const uint64 stdSum = bench("std::unordered_map", [&](uint64 key) { return stdMap.find(key)->second; });
+	EXPECT_EQ(hashSum, treeSum);
+	EXPECT_EQ(hashSum, stdSum);
+}
+
+TEST(Containers, hs_test)
+{
+	HashSet<uint64> set;
+	EXPECT_TRUE(set.begin() == set.end());
+
+	// Bulk insert with duplicates
+	Array<uint64> items(1000);
+	for (uint64 i = 0; i < 1000; ++i) items.push(i % 500);
+	set.insert(items);
+	EXPECT_EQ(500, set.getCount());
+	EXPECT_EQ(7, set.insert(7));
+
+	uint64 numErrors = 0;
+	for (uint64 i = 0; i < 1000; ++i) numErrors += set.contains(i) != (i < 500);
+	EXPECT_EQ(0, numErrors);
+
+	for (uint64 i = 0; i < 500; i += 2) EXPECT_TRUE(set.remove(i));
+	EXPECT_EQ(250, set.getCount());
+
+	// Iterate in slot order
+	uint64 count = 0, sum = 0;
+	const uint64 * prev = nullptr;
+	for (const uint64 & item : set) numErrors += &item <= prev, prev = &item, ++count, sum += item;
+	EXPECT_EQ(0, numErrors);
+	EXPECT_EQ(250, count);
+	EXPECT_EQ(250 * 250, sum);
+
+	// Heterogeneous lookup
+	HashSet<String> names;
+	names.insert(String("sneppy"));
+	names.insert("lpraat");
+	EXPECT_TRUE(names.contains("sneppy"));
+	EXPECT_FALSE(names.contains("Sneppy"));
+
+	ansichar buffer[] = "lpraat";
+	ansichar * key = buffer;
+	EXPECT_TRUE(names.contains(key));
+}
+
+TEST(Containers, hs_ops)
+{
+	// Multiples of 2 and of 3, with some tombstones
+	HashSet<uint64> a, b;
+	for (uint64 i = 0; i < 3000; i += 2) a.insert(i);
+	for (uint64 i = 0; i < 3000; i += 3) b.insert(i);
+	for (uint64 i = 0; i < 3000; i += 10) a.remove(i), b.remove(i);
+
+	auto inA = [](uint64 i) { return i % 2 == 0 && i % 10 != 0; };
+	auto inB = [](uint64 i) { return i % 3 == 0 && i % 10 != 0; };
+
+	const HashSet<uint64> u = a | b;
+	const HashSet<uint64> n = a & b;
+
+	uint64 numErrors = 0, numUnion = 0, numIntersection = 0;
+	for (uint64 i = 0; i < 3000; ++i)
+	{
+		numUnion += inA(i) || inB(i);
+		numIntersection += inA(i) && inB(i);
+		numErrors += u.contains(i) != (inA(i) || inB(i));
+		numErrors += n.contains(i) != (inA(i) && inB(i));
+	}
+	EXPECT_EQ(0, numErrors);
+	EXPECT_EQ(numUnion, u.getCount());
+	EXPECT_EQ(numIntersection, n.getCount());
+
+	// In place
+	HashSet<uint64> c(a);
+	c |= b;
+	EXPECT_EQ(numUnion, c.getCount());
+	c &= a;
+	EXPECT_EQ(a.getCount(), c.getCount());
+	a &= b;
+	EXPECT_EQ(numIntersection, a.getCount());
+	for (uint64 i = 0; i < 3000; ++i) numErrors += a.contains(i) != (inA(i) && inB(i));
+	EXPECT_EQ(0, numErrors);
+
+	// With empty set
+	HashSet<uint64> empty;
+	EXPECT_EQ(0, (b & empty).getCount());
+	EXPECT_EQ(b.getCount(), (empty | b).getCount());
+	b &= empty;
+	EXPECT_TRUE(b.isEmpty());
+}
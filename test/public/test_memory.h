@@ -0,0 +1,1126 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+
+#include "hal/platform_memory.h"
+#include "hal/malloc_ansi.h"
+#include "hal/malloc_binned.h"
+#include "hal/malloc_mapped.h"
+#include "hal/malloc_linear.h"
+#include "hal/malloc_stack.h"
+#include "hal/malloc_tlsf.h"
+#include "hal/malloc_slab.h"
+#include "hal/malloc_tracker.h"
+#include "hal/malloc_policy.h"
+#include "containers/array.h"
+#include "containers/pair.h"
+#include "containers/linked_list.h"
+#include "containers/queue.h"
+#include "containers/binary_tree.h"
+
+/////////////////////////////////////////////////
+// MallocPool tests
+/////////////////////////////////////////////////
+
+TEST(Memory, pool_exhaust)
+{
+	MallocPool pool(1024, 64);
+
+	// Never used blocks, then recycled blocks
+	void * first = pool.malloc(64);
+	for (uint32 i = 1; i < 1024; ++i) EXPECT_NE(nullptr, pool.malloc(64));
+	EXPECT_EQ(nullptr, pool.malloc(64));
+
+	pool.free(first);
+	EXPECT_EQ(first, pool.malloc(64));
+	EXPECT_EQ(nullptr, pool.malloc(64));
+}
+
+TEST(Memory, pool_alignment)
+{
+	MallocPool pool(1024, 48, 16);
+
+	// Blocks are 16 B aligned at most
+	void * block = pool.malloc(48, 16);
+	ASSERT_NE(nullptr, block);
+	EXPECT_EQ(0, reinterpret_cast<uintP>(block) & 15);
+	EXPECT_EQ(nullptr, pool.malloc(48, 32));
+
+	pool.free(block);
+}
+
+/////////////////////////////////////////////////
+// MallocAnsi tests
+/////////////////////////////////////////////////
+
+TEST(Memory, ansi_realloc)
+{
+	MallocAnsi malloc;
+
+	// Usable size covers the request
+	void * block = malloc.malloc(100);
+	sizet usable = 0;
+	EXPECT_TRUE(malloc.getAllocSize(block, usable));
+	EXPECT_EQ(block, malloc.realloc(block, usable));
+	EXPECT_EQ(block, malloc.realloc(block, 50));
+	malloc.free(block);
+
+	// Large blocks keep their contents
+	const sizet n = 1 << 20;
+	uint32 * large = reinterpret_cast<uint32*>(malloc.malloc(n * sizeof(uint32)));
+	for (sizet i = 0; i < n; ++i) large[i] = i;
+
+	large = reinterpret_cast<uint32*>(malloc.realloc(large, 16 * n * sizeof(uint32)));
+	ASSERT_NE(nullptr, large);
+	for (sizet i = 0; i < n; ++i) ASSERT_EQ(i, large[i]);
+	malloc.free(large);
+
+	// Over-aligned blocks stay aligned
+	void * aligned = malloc.malloc(64, 256);
+	aligned = malloc.realloc(aligned, 4096, 256);
+	EXPECT_EQ(0, reinterpret_cast<uintP>(aligned) & 255);
+	malloc.free(aligned);
+}
+
+/////////////////////////////////////////////////
+// MallocMapped tests
+/////////////////////////////////////////////////
+
+TEST(Memory, mapped_alignment)
+{
+	MallocMapped malloc;
+
+	for (uint32 alignment : {8U, 64U, 4096U, 1U << 16})
+	{
+		void * block = malloc.malloc(3 * 1024 * 1024, alignment);
+		ASSERT_NE(nullptr, block);
+		EXPECT_EQ(0, reinterpret_cast<uintP>(block) & (alignment - 1));
+
+		sizet n = 0;
+		EXPECT_TRUE(malloc.getAllocSize(block, n));
+		EXPECT_GE(n, 3 * 1024 * 1024);
+
+		Memory::memset(block, 0xff, n);
+		malloc.free(block);
+	}
+}
+
+TEST(Memory, mapped_realloc)
+{
+	MallocMapped malloc;
+
+	const sizet n = 2 * 1024 * 1024;
+	uint32 * block = reinterpret_cast<uint32*>(malloc.malloc(n * sizeof(uint32)));
+	for (sizet i = 0; i < n; ++i) block[i] = i;
+
+	// Grow, contents are preserved
+	block = reinterpret_cast<uint32*>(malloc.realloc(block, 4 * n * sizeof(uint32)));
+	ASSERT_NE(nullptr, block);
+	for (sizet i = 0; i < n; ++i) ASSERT_EQ(i, block[i]);
+	Memory::memset(block + n, 0, 3 * n * sizeof(uint32));
+
+	// Shrink in place
+	uint32 * shrunk = reinterpret_cast<uint32*>(malloc.realloc(block, n * sizeof(uint32)));
+	EXPECT_EQ(block, shrunk);
+
+	sizet size = 0;
+	EXPECT_TRUE(malloc.getAllocSize(shrunk, size));
+	EXPECT_LT(size, 4 * n * sizeof(uint32));
+	for (sizet i = 0; i < n; ++i) ASSERT_EQ(i, shrunk[i]);
+
+	malloc.free(shrunk);
+}
+
+/////////////////////////////////////////////////
+// MallocLinear tests
+/////////////////////////////////////////////////
+
+TEST(Memory, linear_frames)
+{
+	MallocLinear malloc(4096, 2);
+
+	// Blocks are carved in order
+	void * a = malloc.malloc(100);
+	void * b = malloc.malloc(64, 64);
+	EXPECT_EQ(0, reinterpret_cast<uintP>(b) & 63);
+	EXPECT_GT(b, a);
+
+	// Blocks stay valid for two frames
+	Memory::memset(a, 0xab, 100);
+	malloc.nextFrame();
+	EXPECT_EQ(0xab, *reinterpret_cast<ubyte*>(a));
+	EXPECT_EQ(0, malloc.getFrameUsage());
+
+	// Back to first buffer
+	malloc.nextFrame();
+	EXPECT_EQ(a, malloc.malloc(100));
+}
+
+TEST(Memory, linear_realloc_overflow)
+{
+	MallocLinear malloc(4096, 2);
+
+	// Last block grows in place
+	uint32 * block = reinterpret_cast<uint32*>(malloc.malloc(16 * sizeof(uint32)));
+	for (uint32 i = 0; i < 16; ++i) block[i] = i;
+	EXPECT_EQ(block, malloc.realloc(block, 256 * sizeof(uint32)));
+
+	// Overflows frame buffer
+	block = reinterpret_cast<uint32*>(malloc.realloc(block, 4096 * sizeof(uint32)));
+	ASSERT_NE(nullptr, block);
+	for (uint32 i = 0; i < 16; ++i) EXPECT_EQ(i, block[i]);
+
+	// Overflow blocks are freed with their frame
+	malloc.nextFrame();
+	malloc.nextFrame();
+}
+
+/////////////////////////////////////////////////
+// MallocStack tests
+/////////////////////////////////////////////////
+
+TEST(Memory, stack_markers)
+{
+	MallocStack stack(4096);
+
+	void * a = stack.malloc(100);
+	const MallocStack::Marker marker = stack.pushMarker();
+	const sizet usage = stack.getUsage();
+
+	{
+		// Overflow blocks are released with their marker
+		MallocStack::ScopedMarker scope(&stack);
+		EXPECT_NE(nullptr, stack.malloc(1000));
+		EXPECT_NE(nullptr, stack.malloc(8192));
+		EXPECT_EQ(0, reinterpret_cast<uintP>(stack.malloc(64, 64)) & 63);
+	}
+	EXPECT_EQ(usage, stack.getUsage());
+
+	// Last block grows in place
+	void * b = stack.malloc(16);
+	EXPECT_EQ(b, stack.realloc(b, 512));
+
+	stack.popToMarker(marker);
+	EXPECT_EQ(usage, stack.getUsage());
+	EXPECT_GT(stack.malloc(8), a);
+}
+
+TEST(Memory, stack_per_thread)
+{
+	MallocStack * stack = MallocStack::get();
+	EXPECT_EQ(stack, MallocStack::get());
+
+	// Each thread has its own stack
+	pthread_t thread;
+	MallocStack * other = nullptr;
+	pthread_create(&thread, nullptr, [](void * out) -> void* {
+
+		MallocStack::ScopedMarker marker;
+		*reinterpret_cast<MallocStack**>(out) = MallocStack::get();
+		return MallocStack::get()->malloc(64);
+	}, &other);
+	pthread_join(thread, nullptr);
+
+	EXPECT_NE(nullptr, other);
+	EXPECT_NE(stack, other);
+}
+
+/////////////////////////////////////////////////
+// MallocTLSF tests
+/////////////////////////////////////////////////
+
+TEST(Memory, tlsf_random)
+{
+	MallocTLSF malloc(1 << 20);
+
+	// Random sizes, random frees, blocks must not overlap
+	const uint32 numBlocks = 1024;
+	uint32 * blocks[numBlocks] = {};
+	sizet sizes[numBlocks] = {};
+
+	PlatformMath::initRand(1);
+	for (uint32 i = 0; i < numBlocks * 16; ++i)
+	{
+		const uint32 j = PlatformMath::rand() % numBlocks;
+		if (blocks[j])
+		{
+			for (sizet k = 0; k < sizes[j]; ++k) ASSERT_EQ(j, blocks[j][k]);
+			malloc.free(blocks[j]);
+			blocks[j] = nullptr;
+		}
+		else
+		{
+			sizes[j] = PlatformMath::rand() % 4096 + 1;
+			blocks[j] = reinterpret_cast<uint32*>(malloc.malloc(sizes[j] * sizeof(uint32), 8U << (PlatformMath::rand() % 5)));
+			ASSERT_NE(nullptr, blocks[j]);
+			for (sizet k = 0; k < sizes[j]; ++k) blocks[j][k] = j;
+		}
+	}
+
+	for (uint32 * block : blocks) malloc.free(block);
+}
+
+TEST(Memory, tlsf_alignment_realloc)
+{
+	MallocTLSF malloc;
+
+	for (uint32 alignment = 8; alignment <= 4096; alignment <<= 1)
+	{
+		void * block = malloc.malloc(100, alignment);
+		EXPECT_EQ(0, reinterpret_cast<uintP>(block) & (alignment - 1));
+		malloc.free(block);
+	}
+
+	// Last block grows into free space
+	uint64 * block = reinterpret_cast<uint64*>(malloc.malloc(16 * sizeof(uint64)));
+	for (uint64 i = 0; i < 16; ++i) block[i] = i;
+	uint64 * grown = reinterpret_cast<uint64*>(malloc.realloc(block, 1024 * sizeof(uint64)));
+	EXPECT_EQ(block, grown);
+	for (uint64 i = 0; i < 16; ++i) EXPECT_EQ(i, grown[i]);
+
+	sizet n = 0;
+	EXPECT_TRUE(malloc.getAllocSize(grown, n));
+	EXPECT_GE(n, 1024 * sizeof(uint64));
+
+	// Larger than an area
+	void * large = malloc.malloc(2 * MALLOC_TLSF_AREA_SIZE);
+	ASSERT_NE(nullptr, large);
+	Memory::memset(large, 0, 2 * MALLOC_TLSF_AREA_SIZE);
+
+	malloc.free(large);
+	malloc.free(grown);
+}
+
+/////////////////////////////////////////////////
+// TypedPool tests
+/////////////////////////////////////////////////
+
+TEST(Memory, slab_containers)
+{
+	TypedPool<Link<int32>> links;
+	TypedPool<QueueClient<int32>> clients;
+	LinkedList<int32, PointerAllocator<TypedPool<Link<int32>>>> list(&links);
+	Queue<int32, PointerAllocator<TypedPool<QueueClient<int32>>>> queue(&clients);
+
+	for (int32 i = 0; i < 4096; ++i)
+	{
+		list.push(i);
+		queue.push(i);
+	}
+	EXPECT_EQ(4096, list.getCount());
+	EXPECT_EQ(4096, queue.getLength());
+
+	int32 x, numErrors = 0;
+	for (int32 i = 0; i < 4096; ++i)
+	{
+		numErrors += !queue.pop(x) || x != i;
+		numErrors += !list.popFront(x) || x != i;
+	}
+	EXPECT_EQ(0, numErrors);
+
+	// Freed nodes are reused
+	const uint64 numSlabs = links.getNumSlabs();
+	for (int32 i = 0; i < 4096; ++i) list.push(i);
+	EXPECT_EQ(numSlabs, links.getNumSlabs());
+
+	// Blocks are sized and aligned to the node type
+	EXPECT_EQ(0, reinterpret_cast<uintP>(links.alloc()) % alignof(Link<int32>));
+	EXPECT_EQ(nullptr, links.malloc(sizeof(Link<int32>) + 1));
+}
+
+TEST(Memory, slab_threads)
+{
+	static TypedPool<Link<uint64>> pool;
+	static Link<uint64> * blocks[1 << 14];
+
+	// Allocate on this thread
+	for (auto & block : blocks) block = pool.alloc();
+	const uint64 numSlabs = pool.getNumSlabs();
+	EXPECT_EQ((sizeof(blocks) / sizeof(*blocks) + pool.getNumSlabBlocks() - 1) / pool.getNumSlabBlocks(), numSlabs);
+
+	// Free on another thread, cache is flushed on exit
+	pthread_t thread;
+	pthread_create(&thread, nullptr, [](void*) -> void* {
+
+		for (auto block : blocks) pool.release(block);
+		return nullptr;
+	}, nullptr);
+	pthread_join(thread, nullptr);
+
+	// Blocks freed remotely are reused
+	for (auto & block : blocks) block = pool.alloc();
+	EXPECT_EQ(numSlabs, pool.getNumSlabs());
+
+	for (auto block : blocks) pool.release(block);
+}
+
+TEST(Memory, slab_no_tls)
+{
+	// Use up all TLS slots
+	Array<uint32> slots;
+	for (uint32 slot; PlatformTLS::isValidSlot(slot = PlatformTLS::allocateSlot());) slots.push(slot);
+
+	{
+		// Pool falls back to shared list
+		TypedPool<uint64> pool;
+		uint64 * blocks[1024];
+		for (auto & block : blocks) *(block = pool.alloc()) = 0;
+		for (auto block : blocks) pool.release(block);
+
+		const uint64 numSlabs = pool.getNumSlabs();
+		for (auto & block : blocks) block = pool.alloc();
+		EXPECT_EQ(numSlabs, pool.getNumSlabs());
+
+		for (auto block : blocks) pool.release(block);
+	}
+
+	for (uint32 slot : slots) PlatformTLS::clear(slot);
+}
+
+/////////////////////////////////////////////////
+// MallocTracker tests
+/////////////////////////////////////////////////
+
+TEST(Memory, tracker_tags)
+{
+	MallocAnsi ansi;
+	MallocTracker tracker(&ansi);
+
+	const uint32 render = MallocTracker::registerTag("Test.Render");
+	const uint32 async = MallocTracker::registerTag("Test.Async");
+	EXPECT_EQ(render, MallocTracker::registerTag("Test.Render"));
+	EXPECT_NE(render, async);
+	EXPECT_STREQ("Test.Async", MallocTracker::getTagName(async));
+
+	void * a, * b, * c;
+	{
+		MallocTracker::ScopedTag tag(render);
+		a = tracker.malloc(100);
+		b = tracker.malloc(1000, 64);
+
+		{
+			// Tags nest
+			MallocTracker::ScopedTag tag(async);
+			c = tracker.malloc(24);
+		}
+		EXPECT_EQ(render, MallocTracker::getCurrentTag());
+	}
+	EXPECT_EQ(0, MallocTracker::getCurrentTag());
+	EXPECT_EQ(0, reinterpret_cast<uintP>(b) & 63);
+
+	MallocTracker::TagStats stats = tracker.getTagStats(render);
+	EXPECT_EQ(2, stats.numAllocs);
+	EXPECT_EQ(1100, stats.currBytes);
+	EXPECT_EQ(1, stats.histogram[6]);
+	EXPECT_EQ(1, stats.histogram[9]);
+
+	// Blocks keep their tag when resized or freed elsewhere
+	a = tracker.realloc(a, 4000);
+	tracker.free(b);
+
+	void * args[] = {&tracker, c};
+	pthread_t thread;
+	pthread_create(&thread, nullptr, [](void * args) -> void* {
+
+		void ** blocks = reinterpret_cast<void**>(args);
+		reinterpret_cast<MallocTracker*>(blocks[0])->free(blocks[1]);
+		return nullptr;
+	}, args);
+	pthread_join(thread, nullptr);
+
+	stats = tracker.getTagStats(render);
+	EXPECT_EQ(1, stats.numFrees);
+	EXPECT_EQ(4000, stats.currBytes);
+	EXPECT_EQ(5000, stats.peakBytes);
+
+	stats = tracker.getTagStats(async);
+	EXPECT_EQ(1, stats.numAllocs);
+	EXPECT_EQ(1, stats.numFrees);
+	EXPECT_EQ(0, stats.currBytes);
+	EXPECT_EQ(24, stats.peakBytes);
+
+	sizet size;
+	EXPECT_TRUE(tracker.getAllocSize(a, size));
+	EXPECT_EQ(4000, size);
+	tracker.free(a);
+
+	// Report lists tags with allocations
+	char report[4096] = {};
+	FILE * out = fmemopen(report, sizeof(report) - 1, "w");
+	tracker.dumpReport(out);
+	fclose(out);
+	EXPECT_NE(nullptr, strstr(report, "Test.Render"));
+	EXPECT_NE(nullptr, strstr(report, "Test.Async"));
+}
+
+TEST(Memory, tracker_batch)
+{
+	MallocBinned binned;
+	MallocTracker tracker(&binned);
+
+	const uint32 batch = MallocTracker::registerTag("Test.Batch");
+	MallocTracker::ScopedTag tag(batch);
+
+	void * blocks[100];
+	EXPECT_EQ(100, tracker.mallocBatch(48, 100, blocks, 16));
+
+	uint32 numErrors = 0;
+	for (void * block : blocks) numErrors += (reinterpret_cast<uintP>(block) & 15) != 0;
+	EXPECT_EQ(0, numErrors);
+
+	MallocTracker::TagStats stats = tracker.getTagStats(batch);
+	EXPECT_EQ(100, stats.numAllocs);
+	EXPECT_EQ(100, stats.histogram[5]);
+	EXPECT_EQ(4800, stats.currBytes);
+
+	// Null entries are skipped
+	tracker.free(blocks[50]);
+	blocks[50] = nullptr;
+	tracker.freeBatch(blocks, 99);
+
+	// Sized free reaches the same bin of the inner allocator
+	void * last = blocks[99];
+	tracker.freeSized(last, 48, 16);
+	EXPECT_EQ(last, tracker.malloc(48, 16));
+	tracker.free(last);
+
+	stats = tracker.getTagStats(batch);
+	EXPECT_EQ(101, stats.numAllocs);
+	EXPECT_EQ(101, stats.numFrees);
+	EXPECT_EQ(0, stats.currBytes);
+}
+
+/////////////////////////////////////////////////
+// MallocBinned tests
+/////////////////////////////////////////////////
+
+TEST(Memory, binned_lazy_pools)
+{
+	MallocBinned malloc;
+	EXPECT_EQ(0, malloc.getNumPools());
+
+	// Only the used bucket gets a pool
+	malloc.free(malloc.malloc(64));
+	EXPECT_EQ(1, malloc.getNumPools());
+}
+
+TEST(Memory, binned_alloc_size)
+{
+	MallocBinned malloc;
+
+	// Allocate a block for each bucket
+	void * blocks[MALLOC_BINNED_NUM_BUCKETS];
+	for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+		blocks[i] = malloc.malloc(MallocBinned::getBucketBlockSize(i));
+
+	// Owner pool must report block size
+	for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+	{
+		sizet n = 0;
+		EXPECT_TRUE(malloc.getAllocSize(blocks[i], n));
+		EXPECT_EQ(MallocBinned::getBucketBlockSize(i), n);
+	}
+
+	// Alloc'd by backup allocator
+	void * large = malloc.malloc(MALLOC_BINNED_BLOCK_MAX_SIZE + 1);
+	sizet n = 0;
+	EXPECT_TRUE(malloc.getAllocSize(large, n));
+	EXPECT_GE(n, MALLOC_BINNED_BLOCK_MAX_SIZE + 1);
+	malloc.free(large);
+
+	for (uint32 i = 0; i < MALLOC_BINNED_NUM_BUCKETS; ++i)
+		malloc.free(blocks[i]);
+}
+
+TEST(Memory, binned_size_classes)
+{
+	// Linear classes
+	EXPECT_EQ(8, MallocBinned::getBucketBlockSize(MallocBinned::getBucketIndex(1)));
+	EXPECT_EQ(16, MallocBinned::getBucketBlockSize(MallocBinned::getBucketIndex(9)));
+	EXPECT_EQ(32, MallocBinned::getBucketBlockSize(MallocBinned::getBucketIndex(32)));
+
+	// Four classes per power of two
+	EXPECT_EQ(40, MallocBinned::getBucketBlockSize(MallocBinned::getBucketIndex(33)));
+	EXPECT_EQ(80, MallocBinned::getBucketBlockSize(MallocBinned::getBucketIndex(65)));
+	EXPECT_EQ(1280, MallocBinned::getBucketBlockSize(MallocBinned::getBucketIndex(1025)));
+	EXPECT_EQ(MALLOC_BINNED_BLOCK_MAX_SIZE, MallocBinned::getBucketBlockSize(MALLOC_BINNED_NUM_BUCKETS - 1));
+
+	// Classes are contiguous and never waste more than 25%
+	for (sizet n = 1; n <= MALLOC_BINNED_BLOCK_MAX_SIZE; ++n)
+	{
+		const uint32 i = MallocBinned::getBucketIndex(n);
+		const sizet blockSize = MallocBinned::getBucketBlockSize(i);
+		ASSERT_LT(i, MALLOC_BINNED_NUM_BUCKETS);
+		ASSERT_GE(blockSize, n);
+		ASSERT_TRUE(i == 0 || MallocBinned::getBucketBlockSize(i - 1) < n);
+		ASSERT_TRUE(n <= 8 || blockSize * 4 <= n * 5 + 32);
+	}
+}
+
+TEST(Memory, binned_alignment)
+{
+	MallocBinned malloc;
+
+	for (uint32 alignment = 16; alignment <= 4096; alignment <<= 1)
+		for (sizet n : {1, 24, 100, 1000, 5000})
+		{
+			void * block = malloc.malloc(n, alignment);
+			ASSERT_NE(nullptr, block);
+			EXPECT_EQ(0, reinterpret_cast<uintP>(block) & (alignment - 1));
+
+			// Served by pools
+			sizet size = 0;
+			EXPECT_TRUE(malloc.getAllocSize(block, size));
+			EXPECT_GE(size, n);
+			EXPECT_LT(size, PlatformMath::max<sizet>(n, alignment) * 2);
+
+			malloc.free(block);
+		}
+}
+
+TEST(Memory, binned_realloc)
+{
+	MallocBinned malloc;
+
+	uint64 * block = reinterpret_cast<uint64*>(malloc.malloc(4 * sizeof(uint64)));
+	for (uint64 i = 0; i < 4; ++i) block[i] = i;
+
+	// Grow into a larger bucket
+	block = reinterpret_cast<uint64*>(malloc.realloc(block, 1024 * sizeof(uint64)));
+	for (uint64 i = 0; i < 4; ++i) EXPECT_EQ(i, block[i]);
+
+	malloc.free(block);
+
+	// Shrink a misaligned block, new block is
+	// followed by a block in use
+	uint8 * guards[8];
+	for (uint32 i = 0; i < 8; ++i) PlatformMemory::memset(guards[i] = reinterpret_cast<uint8*>(malloc.malloc(64, 64)), 0xab, 64);
+
+	// Free the lowest one, it's reused first
+	for (uint32 i = 1; i < 8; ++i) if (guards[i] < guards[0]) swap(guards[i], guards[0]);
+	malloc.free(guards[0]);
+
+	uint8 * large = reinterpret_cast<uint8*>(malloc.malloc(112));
+	if ((reinterpret_cast<uintP>(large) & 63) == 0) large = reinterpret_cast<uint8*>(malloc.malloc(112));
+	PlatformMemory::memset(large, 0xcd, 112);
+
+	uint8 * small = reinterpret_cast<uint8*>(malloc.realloc(large, 16, 64));
+	EXPECT_EQ(guards[0], small);
+	EXPECT_EQ(0xcd, small[15]);
+
+	uint32 numErrors = 0;
+	for (uint32 i = 1; i < 8; ++i)
+		for (uint32 j = 0; j < 64; ++j) numErrors += guards[i][j] != 0xab;
+	EXPECT_EQ(0, numErrors);
+
+	malloc.free(small);
+	for (uint32 i = 1; i < 8; ++i) malloc.free(guards[i]);
+}
+
+TEST(Memory, binned_threads)
+{
+	static MallocBinned malloc;
+	static const uint32 numThreads = 4;
+	static const uint32 numBlocks = 1 << 14;
+
+	// Each thread allocates, writes and frees blocks of different sizes
+	auto work = [](void * arg) -> void* {
+
+		const uint64 tag = reinterpret_cast<uint64>(arg);
+		uint64 * blocks[256];
+		uint64 numErrors = 0;
+
+		for (uint32 i = 0; i < numBlocks; i += 256)
+		{
+			for (uint32 j = 0; j < 256; ++j)
+				*(blocks[j] = reinterpret_cast<uint64*>(malloc.malloc(((i + j) % 512) + 8))) = tag;
+			
+			for (uint32 j = 0; j < 256; ++j)
+			{
+				numErrors += *blocks[j] != tag;
+				malloc.free(blocks[j]);
+			}
+		}
+
+		return reinterpret_cast<void*>(numErrors);
+	};
+
+	pthread_t threads[numThreads];
+	for (uint64 i = 0; i < numThreads; ++i)
+		pthread_create(&threads[i], nullptr, work, reinterpret_cast<void*>(i));
+	
+	for (uint64 i = 0; i < numThreads; ++i)
+	{
+		void * numErrors;
+		pthread_join(threads[i], &numErrors);
+		EXPECT_EQ(nullptr, numErrors);
+	}
+}
+
+TEST(Memory, binned_remote_free)
+{
+	static MallocBinned malloc;
+	static void * blocks[1 << 14];
+
+	// Allocate on this thread
+	for (void *& block : blocks) block = malloc.malloc(4096);
+	const uint64 numPools = malloc.getNumPools();
+
+	// Free on another thread
+	pthread_t thread;
+	pthread_create(&thread, nullptr, [](void*) -> void* {
+
+		for (void * block : blocks) malloc.free(block);
+		return nullptr;
+	}, nullptr);
+	pthread_join(thread, nullptr);
+
+	// Remotely freed blocks are reused
+	for (void *& block : blocks) block = malloc.malloc(4096);
+	EXPECT_EQ(numPools, malloc.getNumPools());
+
+	for (void * block : blocks) malloc.free(block);
+}
+
+TEST(Memory, binned_trim)
+{
+	MallocBinned malloc;
+	malloc.setNumRetainedPools(1);
+
+	// Fill three pools of small blocks
+	const sizet numBlocks = 3 * MALLOC_BINNED_POOL_SIZE / 64;
+	void ** blocks = reinterpret_cast<void**>(::malloc(numBlocks * sizeof(void*)));
+	for (sizet i = 0; i < numBlocks; ++i) blocks[i] = malloc.malloc(64);
+	EXPECT_EQ(3, malloc.getNumPools());
+
+	// Pools in use are kept
+	malloc.trim();
+	EXPECT_EQ(3, malloc.getNumPools());
+
+	// Only one free pool is retained
+	for (sizet i = 0; i < numBlocks; ++i) malloc.free(blocks[i]);
+	malloc.trim();
+	EXPECT_EQ(1, malloc.getNumPools());
+
+	// Decommitted pool is still usable
+	for (sizet i = 0; i < numBlocks; ++i)
+	{
+		blocks[i] = malloc.malloc(64);
+		ASSERT_NE(nullptr, blocks[i]);
+		Memory::memset(blocks[i], 0xff, 64);
+	}
+	EXPECT_EQ(3, malloc.getNumPools());
+
+	for (sizet i = 0; i < numBlocks; ++i) malloc.free(blocks[i]);
+	::free(blocks);
+}
+
+TEST(Memory, binned_free_sized)
+{
+	MallocBinned malloc;
+
+	// Sized free reaches the same bin as free
+	void * a = malloc.malloc(100);
+	malloc.freeSized(a, 100);
+	EXPECT_EQ(a, malloc.malloc(100));
+
+	void * b = malloc.malloc(100, 64);
+	malloc.freeSized(b, 100, 64);
+	EXPECT_EQ(b, malloc.malloc(100, 64));
+
+	// Large blocks go to backup allocator
+	void * c = malloc.malloc(MALLOC_BINNED_BLOCK_MAX_SIZE + 1);
+	malloc.freeSized(c, MALLOC_BINNED_BLOCK_MAX_SIZE + 1);
+
+	// Blocks shrunk in place go back to their own bucket
+	void * d = malloc.malloc(112);
+	ASSERT_EQ(d, malloc.realloc(d, 16));
+	malloc.freeSized(d, 16);
+
+	void * e = malloc.malloc(16);
+	EXPECT_NE(d, e);
+	EXPECT_EQ(d, malloc.malloc(112));
+	malloc.free(d);
+	malloc.free(e);
+
+	malloc.free(a);
+	malloc.free(b);
+}
+
+#if SGL_GMALLOC_OPERATORS
+TEST(Memory, global_operators)
+{
+	struct GCC_ALIGN(64) Aligned { uint8 data[64]; };
+
+	// Objects are allocated by gMalloc
+	sizet size;
+	uint64 * array = new uint64[100];
+	EXPECT_TRUE(gMalloc->getAllocSize(array, size));
+	EXPECT_GE(size, 800);
+	delete[] array;
+
+	Aligned * aligned = new Aligned;
+	EXPECT_EQ(0, reinterpret_cast<uintP>(aligned) & 63);
+	EXPECT_TRUE(gMalloc->getAllocSize(aligned, size));
+	delete aligned;
+}
+#endif
+
+TEST(Memory, binned_batch)
+{
+	MallocBinned malloc;
+	void * blocks[1000];
+
+	// Blocks span cache bin and pools
+	EXPECT_EQ(1000, malloc.mallocBatch(48, 1000, blocks));
+	std::sort(blocks, blocks + 1000);
+	EXPECT_EQ(blocks + 1000, std::unique(blocks, blocks + 1000));
+	for (void * block : blocks) *reinterpret_cast<uint64*>(block) = 0;
+
+	malloc.freeBatch(blocks, 1000);
+	EXPECT_EQ(1000, malloc.mallocBatch(48, 1000, blocks, 16));
+	for (void * block : blocks) EXPECT_EQ(0, reinterpret_cast<uintP>(block) & 15);
+	EXPECT_EQ(1, malloc.getNumPools());
+
+	// Large blocks use the generic path
+	EXPECT_EQ(2, malloc.mallocBatch(MALLOC_BINNED_BLOCK_MAX_SIZE * 2, 2, blocks + 1000 - 2));
+	malloc.freeBatch(blocks, 1000);
+}
+
+TEST(Memory, batch_containers)
+{
+	MallocBinned malloc;
+
+	Queue<uint64, PointerAllocator<MallocBinned>> queue(&malloc);
+	for (uint64 i = 0; i < 1000; ++i) queue.push(i);
+
+	// Copy allocates clients in batches
+	Queue<uint64, PointerAllocator<MallocBinned>> copy(&malloc);
+	copy = queue;
+	EXPECT_EQ(1000, copy.getLength());
+
+	uint64 x, numErrors = 0;
+	for (uint64 i = 0; i < 1000; ++i) numErrors += !copy.pop(x) || x != i;
+	EXPECT_EQ(0, numErrors);
+
+	BinaryTree<uint64, Compare, PointerAllocator<MallocBinned>> tree(&malloc);
+	for (uint64 i = 0; i < 1000; ++i) tree.insert(i);
+
+	BinaryTree<uint64, Compare, PointerAllocator<MallocBinned>> treeCopy(tree);
+	EXPECT_EQ(tree.getSize(), treeCopy.getSize());
+	for (uint64 i = 0; i < 1000; ++i) numErrors += treeCopy.find(i) == treeCopy.end();
+	EXPECT_EQ(0, numErrors);
+}
+
+TEST(Memory, policy_containers)
+{
+	// Stateless policies take no space
+	EXPECT_TRUE(std::is_empty<HeapAllocator>::value);
+	EXPECT_TRUE(std::is_empty<StaticAllocator<MallocTLSF>>::value);
+	EXPECT_EQ(32, sizeof(Array<uint64>));
+	EXPECT_EQ(32, sizeof(Queue<uint64>));
+	EXPECT_EQ(32, sizeof(LinkedList<uint64>));
+	EXPECT_EQ(32, sizeof(BinaryTree<uint64>));
+
+	// All containers of a static policy share an instance
+	Array<uint64, StaticAllocator<MallocBinned>> array;
+	LinkedList<uint64, StaticAllocator<MallocBinned>> list;
+	for (uint64 i = 0; i < 1000; ++i)
+	{
+		array.push(i);
+		list.push(i);
+	}
+
+	uint64 x, numErrors = 0;
+	for (uint64 i = 0; i < 1000; ++i) numErrors += array[i] != i || !list.popFront(x) || x != i;
+	EXPECT_EQ(0, numErrors);
+	EXPECT_EQ(StaticAllocator<MallocBinned>::get(), PointerAllocator<MallocBinned>().allocator);
+
+	// Copies keep the allocator of a pointer policy
+	MallocBinned malloc;
+	Queue<uint64, PointerAllocator<MallocBinned>> queue(&malloc);
+	queue.push(1);
+
+	Queue<uint64, PointerAllocator<MallocBinned>> copy(queue);
+	Queue<uint64, PointerAllocator<MallocBinned>> moved((Queue<uint64, PointerAllocator<MallocBinned>>&&)queue);
+	EXPECT_EQ(&malloc, copy.getAllocator().allocator);
+	EXPECT_EQ(&malloc, moved.getAllocator().allocator);
+	EXPECT_TRUE(copy.pop(x) && x == 1);
+	EXPECT_TRUE(moved.pop(x) && x == 1);
+}
+
+TEST(Memory, binned_occupancy)
+{
+	MallocBinned malloc;
+	const uint32 bucketIdx = MallocBinned::getBucketIndex(64);
+
+	// Keep only blocks in first slot of the pool
+	void * blocks[4096];
+	for (void *& block : blocks) block = malloc.malloc(64);
+
+	uint32 numUsedBlocks = 0;
+	for (void * block : blocks)
+		if ((reinterpret_cast<uintP>(block) & (MALLOC_BINNED_POOL_SIZE - 1)) >= MALLOC_BINNED_OCCUPANCY_SLOT_SIZE)
+			malloc.free(block);
+		else
+			++numUsedBlocks;
+
+	MallocBinned::BucketStats stats[MALLOC_BINNED_NUM_BUCKETS];
+	malloc.getBucketStats(stats);
+	EXPECT_EQ(64, stats[bucketIdx].blockSize);
+	EXPECT_EQ(1, stats[bucketIdx].numPools);
+	EXPECT_EQ(MALLOC_BINNED_POOL_SIZE / 64, stats[bucketIdx].numBlocks);
+	EXPECT_EQ(MALLOC_BINNED_OCCUPANCY_SLOT_SIZE / 64, numUsedBlocks);
+	EXPECT_EQ(numUsedBlocks, stats[bucketIdx].getNumUsedBlocks());
+	EXPECT_EQ(0, stats[0].numPools);
+
+	// Cached blocks don't show up in bitmaps
+	malloc.trim();
+
+	const sizet reportSize = 64 * 1024;
+	char * report = reinterpret_cast<char*>(::calloc(1, reportSize));
+	FILE * out = fmemopen(report, reportSize - 1, "w");
+	EXPECT_TRUE(malloc.writeStats(out));
+	fclose(out);
+
+	const char * bucket = strstr(report, "{\"blockSize\":64,\"pools\":1,");
+	ASSERT_NE(nullptr, bucket);
+	const char * bitmap = strstr(bucket, "\"bitmaps\":[\"");
+	ASSERT_NE(nullptr, bitmap);
+	bitmap += 12;
+
+	EXPECT_EQ('1', bitmap[0]);
+	EXPECT_EQ(MALLOC_BINNED_POOL_SIZE / MALLOC_BINNED_OCCUPANCY_SLOT_SIZE, strchr(bitmap, '"') - bitmap);
+	EXPECT_EQ(MALLOC_BINNED_POOL_SIZE / MALLOC_BINNED_OCCUPANCY_SLOT_SIZE - 1, std::count(bitmap, strchr(bitmap, '"'), '0'));
+	EXPECT_EQ('\n', report[strlen(report) - 1]);
+
+	::free(report);
+	for (void * block : blocks)
+		if ((reinterpret_cast<uintP>(block) & (MALLOC_BINNED_POOL_SIZE - 1)) < MALLOC_BINNED_OCCUPANCY_SLOT_SIZE)
+			malloc.free(block);
+}
+
+TEST(Memory, binned_numa_topology)
+{
+	static MallocBinned malloc;
+	static thread_local uint32 fakeNode = 0;
+
+	EXPECT_LT(PlatformMemory::getCurrentNode(), PlatformMemory::getNumNodes());
+
+	// Fake two nodes, each thread picks its own
+	malloc.setTopology(2, []() -> uint32 { return fakeNode; });
+	EXPECT_EQ(2, malloc.getNumNodes());
+
+	// Allocate a cached and an uncached block on a node
+	auto work = [](void * arg) -> void* {
+
+		fakeNode = uint32(reinterpret_cast<uintP>(arg));
+
+		void ** blocks = reinterpret_cast<void**>(::malloc(2 * sizeof(void*)));
+		blocks[0] = malloc.malloc(64);
+		blocks[1] = malloc.malloc(MALLOC_BINNED_BLOCK_MAX_SIZE);
+		return blocks;
+	};
+
+	void * blocks[3][2];
+	for (uintP i = 0; i < 3; ++i)
+	{
+		void * out;
+		pthread_t thread;
+		pthread_create(&thread, nullptr, work, reinterpret_cast<void*>(i & 1));
+		pthread_join(thread, &out);
+
+		Memory::memcpy(blocks[i], out, sizeof(blocks[i]));
+		::free(out);
+	}
+
+	// Each node has its own pools, threads of the same node share them
+	auto getPoolSlot = [](void * block) { return reinterpret_cast<uintP>(block) / MALLOC_BINNED_POOL_SIZE; };
+	EXPECT_EQ(4, malloc.getNumPools());
+	EXPECT_NE(getPoolSlot(blocks[0][0]), getPoolSlot(blocks[1][0]));
+	EXPECT_NE(getPoolSlot(blocks[0][1]), getPoolSlot(blocks[1][1]));
+	EXPECT_EQ(getPoolSlot(blocks[0][0]), getPoolSlot(blocks[2][0]));
+	EXPECT_EQ(getPoolSlot(blocks[0][1]), getPoolSlot(blocks[2][1]));
+
+	for (auto & it : blocks)
+	{
+		malloc.free(it[0]);
+		malloc.free(it[1]);
+	}
+}
+
+/////////////////////////////////////////////////
+// MallocBinned benchmarks
+/////////////////////////////////////////////////
+
+TEST(Memory, binned_free_latency)
+{
+	// Largest bucket, fewest blocks per pool
+	const sizet blockSize = MALLOC_BINNED_BLOCK_MAX_SIZE;
+	const uint32 numRuns = 1 << 16;
+
+	for (uint32 numPools : {1U, 8U, 64U})
+	{
+		MallocBinned malloc;
+		Array<void*> blocks(64);
+
+		// Fill pools
+		while (malloc.getNumPools() < numPools)
+			blocks.push(malloc.malloc(blockSize));
+
+		// Free and reallocate a block owned by the first pool
+		void * block = blocks[0];
+		const auto begin = std::chrono::high_resolution_clock::now();
+		for (uint32 i = 0; i < numRuns; ++i)
+		{
+			malloc.free(block);
+			block = malloc.malloc(blockSize);
+		}
+		const auto end = std::chrono::high_resolution_clock::now();
+		blocks[0] = block;
+
+		printf("binned free+malloc, %3u pools: %.2f ns\n", numPools, std::chrono::duration<float64, std::nano>(end - begin).count() / numRuns);
+
+		for (void * it : blocks)
+			malloc.free(it);
+	}
+}
+
+TEST(Memory, binned_numa_local_access)
+{
+	if (PlatformMemory::getNumNodes() < 2)
+	{
+		printf("binned numa: single node, skipped\n");
+		return;
+	}
+
+	static MallocBinned * malloc;
+	static void * blocks[1 << 13];
+	static const sizet blockSize = 4096;
+	static const uint32 numPasses = 16;
+
+	// Pins calling thread to the first cpu of a node
+	static auto pinToNode = [](uint32 node) {
+
+		char path[64];
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+		uint32 cpu = 0;
+		if (FILE * file = fopen(path, "r"))
+		{
+			if (fscanf(file, "%u", &cpu) != 1) cpu = 0;
+			fclose(file);
+		}
+
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	};
+
+	// First touch pages on node 0, then give them back
+	auto produce = [](void*) -> void* {
+
+		pinToNode(0);
+		for (void *& block : blocks) Memory::memset(block = malloc->malloc(blockSize), 1, blockSize);
+		for (void * block : blocks) malloc->free(block);
+		return nullptr;
+	};
+
+	// Allocate on node 1 and read the blocks
+	auto consume = [](void*) -> void* {
+
+		pinToNode(1);
+		for (void *& block : blocks) Memory::memset(block = malloc->malloc(blockSize), 2, blockSize);
+
+		uint64 sum = 0;
+		const auto begin = std::chrono::high_resolution_clock::now();
+		for (uint32 i = 0; i < numPasses; ++i)
+			for (void * block : blocks)
+				for (const uint64 * it = reinterpret_cast<uint64*>(block), * end = it + blockSize / sizeof(uint64); it != end; ++it) sum += *it;
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		for (void * block : blocks) malloc->free(block);
+
+		const float64 numBytes = float64(numPasses) * sizeof(blocks) / sizeof(void*) * blockSize;
+		printf("binned %s pools: %.2f GB/s (%llu)\n",
+			malloc->getNumNodes() > 1 ? "node-local" : "shared    ",
+			numBytes / std::chrono::duration<float64, std::nano>(end - begin).count(),
+			(unsigned long long)sum);
+		return nullptr;
+	};
+
+	for (uint32 numNodes : {1U, 2U})
+	{
+		MallocBinned binned;
+		binned.setTopology(numNodes);
+		malloc = &binned;
+
+		pthread_t thread;
+		pthread_create(&thread, nullptr, produce, nullptr);
+		pthread_join(thread, nullptr);
+		pthread_create(&thread, nullptr, consume, nullptr);
+		pthread_join(thread, nullptr);
+	}
+}
+
+/////////////////////////////////////////////////
+// Allocators benchmarks
+/////////////////////////////////////////////////
+
+TEST(Memory, tail_latency)
+{
+	const uint32 numBlocks = 4096;
+	const uint32 numRuns = 1 << 18;
+
+	MallocAnsi ansi;
+	MallocBinned binned;
+	MallocTLSF tlsf;
+	const Pair<const char*, Malloc*> allocators[] = {{"ansi", &ansi}, {"binned", &binned}, {"tlsf", &tlsf}};
+
+	void ** blocks = reinterpret_cast<void**>(::calloc(numBlocks, sizeof(void*)));
+	uint32 * samples = reinterpret_cast<uint32*>(::malloc(numRuns * sizeof(uint32)));
+
+	for (const auto & allocator : allocators)
+	{
+		Malloc * malloc = allocator.second;
+
+		// Same random sequence of mallocs and frees, 16 B to 64 KB
+		PlatformMath::initRand(1);
+		for (uint32 i = 0; i < numRuns; ++i)
+		{
+			const uint32 j = PlatformMath::rand() % numBlocks;
+			const sizet n = 16 << (PlatformMath::rand() % 13);
+
+			const auto begin = std::chrono::high_resolution_clock::now();
+			if (blocks[j])
+			{
+				malloc->free(blocks[j]);
+				blocks[j] = nullptr;
+			}
+			else
+				blocks[j] = malloc->malloc(n);
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+		}
+
+		for (uint32 i = 0; i < numBlocks; ++i)
+		{
+			malloc->free(blocks[i]);
+			blocks[i] = nullptr;
+		}
+
+		std::sort(samples, samples + numRuns);
+		printf("%-6s p50: %6u ns, p99: %6u ns, p99.9: %6u ns, max: %8u ns\n",
+			allocator.first,
+			samples[numRuns / 2],
+			samples[numRuns * 99 / 100],
+			samples[numRuns * 999 / 1000],
+			samples[numRuns - 1]);
+	}
+
+	::free(samples);
+	::free(blocks);
+}
\ No newline at end of file